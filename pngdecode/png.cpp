@@ -534,6 +534,8 @@ namespace cmps3120
   void png_receptor::set_pixel
       (unsigned int x, unsigned int y, unsigned int level, png_pixel v)
       { /*pass*/return; }
+  const unsigned char* png_receptor::get_row(unsigned int y)
+      { return NULL; }
   
   png_base::png_base(void)
   : m_xerr(0), m_receptor(NULL)
@@ -410,6 +410,10 @@ namespace cmps3120
    * will be sent through the set_header method, while
    * the pixel values will be sent through the set
    * method.
+   *
+   * The png_encoder reads the pixels through get_pixel,
+   * or whole scanlines through get_row when the receptor
+   * overrides it.
    * 
    */
   class png_receptor
@@ -425,6 +429,20 @@ namespace cmps3120
       (unsigned int x, unsigned int y, unsigned int level);
     virtual void set_pixel
       (unsigned int x, unsigned int y, unsigned int level, png_pixel v);
+    /**
+     * Bulk access to a scanline of a non interlaced image.
+     * @param y the row
+     * @return the bytes of the row as stored in the file (packed
+     *   samples, 16-bit samples big endian, no filter type byte),
+     *   or NULL to be read through get_pixel.
+     * @note a single stream encoder copies the row : the bytes must
+     *   stay valid until the next call. The parallel encoder
+     *   (png_encoder::set_threads) asks for every row before
+     *   compressing and keeps the pointers : the bytes must stay
+     *   valid until the end of the write.
+     */
+    virtual const unsigned char* get_row
+      (unsigned int y);
   };
 
   /**
@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <time.h>
 #include <string.h>
+#include <vector>
 
 namespace cmps3120
 {
@@ -20,6 +21,76 @@ namespace cmps3120
   unsigned char pngenc_chunk_idat[4] =
     { 0x49, 0x44, 0x41, 0x54 };
 
+  /* parallel mode : uncompressed bytes per band, and dictionary */
+  static const unsigned int pngenc_band_size = 262144;
+  static const unsigned int pngenc_dict_size = 32768;
+
+  /**
+   * Filter with the minimum sum of absolute differences.
+   * @param row the raw scanline
+   * @param prev the previous raw scanline, zeros for the first one
+   * @param n the number of bytes in a scanline
+   * @param dist the number of bytes in a pixel, at least 1
+   * @return the filter type
+   */
+  static unsigned int pngenc_choose_filter(const unsigned char* row,
+    const unsigned char* prev, unsigned int n, unsigned int dist)
+  {
+    /* sum of the absolute values of the filtered bytes (as signed
+     *   bytes) for each filter, the smallest wins */
+    unsigned long int sums[5] = {0, 0, 0, 0, 0};
+    unsigned int i, f, best = 0;
+    for (i = 0; i < n; i++)
+    {
+      unsigned int x = row[i], a = 0, b = prev[i], c = 0;
+      if (i >= dist)
+      {
+        a = row[i-dist];
+        c = prev[i-dist];
+      }
+      unsigned char d[5];
+      d[0] = x;
+      d[1] = x-a;
+      d[2] = x-b;
+      d[3] = x-((a+b)>>1);
+      d[4] = x-png_paeth_predict(a,b,c);
+      for (f = 0; f < 5; f++)
+        sums[f] += (d[f] < 128) ? d[f] : 256-d[f];
+    }
+    for (f = 1; f < 5; f++)
+    {
+      if (sums[f] < sums[best])
+        best = f;
+    }
+    return best;
+  }
+
+  /**
+   * Filter a whole scanline.
+   * @param[out] out receives the filter type then the n filtered bytes
+   */
+  static void pngenc_filter_row(const unsigned char* row,
+    const unsigned char* prev, unsigned int n, unsigned int dist,
+    unsigned char* out)
+  {
+    unsigned int i, f = pngenc_choose_filter(row, prev, n, dist);
+    *out++ = f;
+    for (i = 0; i < n; i++)
+    {
+      unsigned int a = (i >= dist) ? row[i-dist] : 0;
+      unsigned int c = (i >= dist) ? prev[i-dist] : 0;
+      switch (f)
+      {
+      case 0: out[i] = row[i]; break;
+      case 1: out[i] = (row[i]-a)&255; break;
+      case 2: out[i] = (row[i]-prev[i])&255; break;
+      case 3: out[i] = (row[i]-((a+prev[i])>>1))&255; break;
+      default:
+        out[i] = (row[i]-png_paeth_predict(a,prev[i],c))&255; break;
+      }
+    }
+  }
+
   png_enc_random::png_enc_random(unsigned int v)
     : m_v(v)
   {
@@ -56,7 +127,9 @@ namespace cmps3120
   
   
   png_encoder::png_encoder(void)
-    : xenc(), m_max(100000), m_d_chunk_size(1024)
+    : xenc(), m_max(100000), m_d_chunk_size(1024), m_mode(png_enc_classic),
+      m_row_ready(false), m_threads(1), m_parallel(false), m_stream_pos(0),
+      m_chunk(NULL)
   {
     reset();
   }
@@ -72,21 +145,43 @@ namespace cmps3120
   {
     m_max = x;
   }
+  png_enc_mode png_encoder::get_mode(void) const
+  {
+    return m_mode;
+  }
+  void png_encoder::set_mode(png_enc_mode m)
+  {
+    m_mode = m;
+    xenc.set_match_mode(m == png_enc_heuristic
+      ? zenc_match_chain : zenc_match_simple);
+    /* fewer, longer IDAT chunks go with the longer deflate blocks */
+    m_d_chunk_size = (m == png_enc_heuristic) ? 32768 : 1024;
+  }
+  unsigned int png_encoder::get_threads(void) const
+  {
+    return m_threads;
+  }
+  void png_encoder::set_threads(unsigned int n)
+  {
+    m_threads = n ? n : 1;
+  }
   png_error png_encoder::write_file(const char* name)
   {
     FILE *nfile = fopen(name,"wb");
     if (nfile != NULL)
     {
       unsigned int readch; unsigned char buf[256];
+      bool failed = false;
       reset();
-      while (!get_error())
+      while (!get_error() && !failed)
       {
         get(buf,256,&readch);
         if (readch > 0)
-          fwrite(buf,sizeof(unsigned char),readch,nfile);
+          failed = fwrite(buf,sizeof(unsigned char),readch,nfile)
+            != readch;
       }
-      fclose(nfile);
-      return get_error();
+      failed = (fclose(nfile) != 0) || failed;
+      return failed ? PNG_FILE_WRITE_FAILED : get_error();
     } else {
       return PNG_FILE_WRITE_FAILED;
     }
@@ -434,26 +529,47 @@ namespace cmps3120
             {
               out = PNG_UNSUPPORTED_HEADER;
             }
+            m_parallel = (m_threads > 1) && (m_mode == png_enc_heuristic)
+              && (get_header().interlace_type == 0) && (!out);
+            if (m_parallel)
+            {
+              m_stream_pos = 0;
+              if (generate_parallel())
+                out = PNG_ZSS_ERROR;
+            }
           }
           xenc.clear_pending();
           submode++;
         }
         if (submode == 1)
         {
-          while ((xenc.get_pending_count() < m_d_chunk_size)
-              && (readmode < 19)
-              && (!err))
+          if (m_parallel)
           {
-            xbuf[0] = generate_sample();
-            err = xenc.put(&xbuf[0],1,NULL);
+            /* next chunk of the stream compressed beforehand */
+            xlong = m_stream.size()-m_stream_pos;
+            if (xlong > m_d_chunk_size)
+              xlong = m_d_chunk_size;
+            m_chunk = m_stream.data()+m_stream_pos;
+            m_stream_pos += xlong;
+            if (m_stream_pos >= m_stream.size())
+              readmode = 19;
+          } else {
+            while ((xenc.get_pending_count() < m_d_chunk_size)
+                && (readmode < 19)
+                && (!err))
+            {
+              xbuf[0] = generate_sample();
+              err = xenc.put(&xbuf[0],1,NULL);
+            }
+            if ((readmode >= 19)
+            &&  (!err))
+              err = xenc.finish();
+            if (err && (err != 1)) out = PNG_ZSS_ERROR;
+            xlong = xenc.get_pending_count();
+            m_chunk = xenc.get_pending().data();
           }
           m_pendpos = 0;
-          if ((readmode >= 19)
-          &&  (!err))
-            err = xenc.finish();
-          if (err && (err != 1)) out = PNG_ZSS_ERROR;
           submode++;
-          xlong = xenc.get_pending_count();
         }
         if (submode == 2)
         {
@@ -482,10 +598,10 @@ namespace cmps3120
         }
         if (submode == 4)
         {
-          if (m_pendpos < xenc.get_pending_count())
+          if (m_pendpos < xlong)
           {
-            y = xenc.get_pending()[m_pendpos];
-            put_previous(xenc.get_pending()[m_pendpos]);
+            y = m_chunk[m_pendpos];
+            put_previous(m_chunk[m_pendpos]);
             m_pendpos++;
           } else {
             submode = 5;
@@ -555,13 +671,33 @@ namespace cmps3120
     int ch = 0;
     unsigned char xc;
     int xreadmode = get_interlace_data().get_level()+10;
-    unsigned int i, lv;
     if (xreadmode == 10) xreadmode = 9;
     switch (sidemode)
     {
     case 0: /* filter */
       {
-        filter_typ = m_rand%5u;
+        const unsigned char *row = NULL;
+        if ((get_receptor() != NULL)
+        &&  (get_interlace_data().get_level() == 0))
+          row = get_receptor()->get_row(xdiv_ypos);
+        m_row_ready = (row != NULL) || (m_mode == png_enc_heuristic);
+        if (row != NULL)
+        {
+          /* the receptor gives the whole scanline at once */
+          m_row.resize(filter_backlog.size());
+          if (m_row.size())
+            memcpy(m_row.data(), row, m_row.size());
+        } else if (m_mode == png_enc_heuristic)
+        {
+          /* the whole scanline is needed to choose its filter */
+          m_row.resize(filter_backlog.size());
+          for (xdiv_index = 0; xdiv_index < m_row.size(); xdiv_index++)
+            m_row[xdiv_index] = generate_raw_sample();
+          xdiv_xpos = 0;
+        }
+        if (m_mode == png_enc_heuristic)
+          filter_typ = choose_filter();
+        else filter_typ = m_rand%5u;
         sidemode++;
         xdiv_index=0;
         ch = filter_typ;
@@ -570,288 +706,11 @@ namespace cmps3120
       }break;
     case 1: /* data */
       {
-        if (get_receptor() != NULL)
-        {
-          png_receptor *rcpt = get_receptor();
-          png_adam7_data &idta = get_interlace_data();
-          switch (get_header().bit_depth)
-          {
-          case 1:
-            {
-              xc = 0;
-              if (get_header().color_type & PNG_HAS_PALETTE)
-              {
-                for (i = 0; (i < 8)&&(xdiv_xpos<xdiv_width);
-                    i++, xdiv_xpos++)
-                {
-                 
-                  lv = get_palette().closest_match
-                    (rcpt->get_pixel
-                      (idta.real_x(xdiv_xpos),idta.real_y(xdiv_ypos),
-                       idta.get_level()), 2);
-                  xc |= ((lv&1)<<(7-i));
-                }
-              } else {
-                for (i = 0; (i < 8)&&(xdiv_xpos<xdiv_width);
-                    i++, xdiv_xpos++)
-                {
-                 
-                  lv = (rcpt->get_pixel
-                      (idta.real_x(xdiv_xpos),idta.real_y(xdiv_ypos),
-                       idta.get_level()).gray()>>15);
-                  xc |= ((lv&1)<<(7-i));
-                }
-              }
-            }break;
-          case 2:
-            {
-              xc = 0;
-              if (get_header().color_type & PNG_HAS_PALETTE)
-              {
-                for (i = 0; (i < 4)&&(xdiv_xpos<xdiv_width);
-                    i++, xdiv_xpos++)
-                {
-                 
-                  lv = get_palette().closest_match
-                    (rcpt->get_pixel
-                      (idta.real_x(xdiv_xpos),idta.real_y(xdiv_ypos),
-                       idta.get_level()), 4);
-                  xc |= ((lv&3)<<((3-i)<<1));
-                }
-              } else {
-                for (i = 0; (i < 4)&&(xdiv_xpos<xdiv_width);
-                    i++, xdiv_xpos++)
-                {
-                 
-                  lv = (rcpt->get_pixel
-                      (idta.real_x(xdiv_xpos),idta.real_y(xdiv_ypos),
-                       idta.get_level()).gray()>>14);
-                  xc |= ((lv&3)<<((3-i)<<1));
-                }
-              }
-            }break;
-          case 4:
-            {
-              xc = 0;
-              if (get_header().color_type & PNG_HAS_PALETTE)
-              {
-                for (i = 0; (i < 2)&&(xdiv_xpos<xdiv_width);
-                    i++, xdiv_xpos++)
-                {
-                 
-                  lv = get_palette().closest_match
-                    (rcpt->get_pixel
-                      (idta.real_x(xdiv_xpos),idta.real_y(xdiv_ypos),
-                       idta.get_level()), 16);
-                  xc |= ((lv&15)<<((1-i)<<2));
-                }
-              } else {
-                for (i = 0; (i < 2)&&(xdiv_xpos<xdiv_width);
-                    i++, xdiv_xpos++)
-                {
-                 
-                  lv = (rcpt->get_pixel
-                      (idta.real_x(xdiv_xpos),idta.real_y(xdiv_ypos),
-                       idta.get_level()).gray()>>12);
-                  xc |= ((lv&15)<<((1-i)<<2));
-                }
-              }
-            }break;
-          case 8:
-            {
-              if (get_header().color_type == 0)
-              {
-                xc = (rcpt->get_pixel
-                    (idta.real_x(xdiv_xpos),idta.real_y(xdiv_ypos),
-                     idta.get_level()).gray()>>8);
-                xdiv_xpos++;
-              } else if (get_header().color_type == 2)
-              {
-                switch (xdiv_index%3)
-                {
-                  case 0:
-                    m_tmptrns = rcpt->get_pixel
-                      (idta.real_x(xdiv_xpos),idta.real_y(xdiv_ypos),
-                       idta.get_level());
-                    xc = m_tmptrns.r>>8;
-                    break;
-                  case 1:
-                    xc = m_tmptrns.g>>8;
-                    break;
-                  case 2:
-                    xc = m_tmptrns.b>>8;
-                    xdiv_xpos++;
-                    break;
-                }
-              } else if (get_header().color_type == 3)
-              {
-                lv = get_palette().closest_match
-                  (rcpt->get_pixel
-                    (idta.real_x(xdiv_xpos),idta.real_y(xdiv_ypos),
-                     idta.get_level()), 256);
-                xc = lv;
-                xdiv_xpos++;
-              } else if (get_header().color_type == 4)
-              {
-                switch (xdiv_index%2)
-                {
-                  case 0:
-                    m_tmptrns = rcpt->get_pixel
-                      (idta.real_x(xdiv_xpos),idta.real_y(xdiv_ypos),
-                       idta.get_level());
-                    xc = m_tmptrns.gray()>>8;
-                    break;
-                  case 1:
-                    xc = m_tmptrns.a>>8;
-                    xdiv_xpos++;
-                    break;
-                }
-              } else if (get_header().color_type == 6)
-              {
-                switch (xdiv_index%4)
-                {
-                  case 0:
-                    m_tmptrns = rcpt->get_pixel
-                      (idta.real_x(xdiv_xpos),idta.real_y(xdiv_ypos),
-                       idta.get_level());
-                    xc = m_tmptrns.r>>8;
-                    break;
-                  case 1:
-                    xc = m_tmptrns.g>>8;
-                    break;
-                  case 2:
-                    xc = m_tmptrns.b>>8;
-                    break;
-                  case 3:
-                    xc = m_tmptrns.a>>8;
-                    xdiv_xpos++;
-                    break;
-                }
-              }
-            }break;
-          case 16:
-            {
-              if (get_header().color_type == 0)
-              {
-                switch (xdiv_index%2)
-                {
-                case 0:
-                  m_tmptrns.r = (rcpt->get_pixel
-                    (idta.real_x(xdiv_xpos),idta.real_y(xdiv_ypos),
-                     idta.get_level()).gray());
-                  xc = (m_tmptrns.r>>8)&255;
-                  break;
-                case 1:
-                  xc = (m_tmptrns.r)&255;
-                  xdiv_xpos++;
-                  break;
-                }
-              } else if (get_header().color_type == 2)
-              {
-                switch (xdiv_index%6)
-                {
-                  case 0:
-                    m_tmptrns = rcpt->get_pixel
-                      (idta.real_x(xdiv_xpos),idta.real_y(xdiv_ypos),
-                       idta.get_level());
-                    xc = (m_tmptrns.r>>8)&255;
-                    break;
-                  case 1:
-                    xc = (m_tmptrns.r&255);
-                    break;
-                  case 2:
-                    xc = (m_tmptrns.g>>8)&255;
-                    break;
-                  case 3:
-                    xc = (m_tmptrns.g&255);
-                    break;
-                  case 4:
-                    xc = (m_tmptrns.b>>8)&255;
-                    break;
-                  case 5:
-                    xc = (m_tmptrns.b&255);
-                    xdiv_xpos++;
-                    break;
-                }
-              } else if (get_header().color_type == 3)
-              {
-                switch (xdiv_index%2)
-                {
-                  case 0:
-                    m_tmptrns.r = get_palette().closest_match
-                      (rcpt->get_pixel
-                        (idta.real_x(xdiv_xpos),idta.real_y(xdiv_ypos),
-                        idta.get_level()), 65535);
-                    xc = (m_tmptrns.r>>8)&255;
-                    break;
-                  case 1:
-                    xc = (m_tmptrns.r)&255;
-                    xdiv_xpos++;
-                }
-              } else if (get_header().color_type == 4)
-              {
-                switch (xdiv_index%4)
-                {
-                  case 0:
-                    m_tmptrns = rcpt->get_pixel
-                      (idta.real_x(xdiv_xpos),idta.real_y(xdiv_ypos),
-                       idta.get_level());
-                    m_tmptrns.r = m_tmptrns.gray();
-                    xc = (m_tmptrns.r>>8)&255;
-                    break;
-                  case 1:
-                    xc = (m_tmptrns.r)&255;
-                    break;
-                  case 2:
-                    xc = (m_tmptrns.a>>8)&255;
-                    break;
-                  case 3:
-                    xc = (m_tmptrns.a)&255;
-                    xdiv_xpos++;
-                    break;
-                }
-              } else if (get_header().color_type == 6)
-              {
-                switch (xdiv_index%8)
-                {
-                  case 0:
-                    m_tmptrns = rcpt->get_pixel
-                      (idta.real_x(xdiv_xpos),idta.real_y(xdiv_ypos),
-                       idta.get_level());
-                    xc = (m_tmptrns.r>>8)&255;
-                    break;
-                  case 1:
-                    xc = m_tmptrns.r&255;
-                    break;
-                  case 2:
-                    xc = (m_tmptrns.g>>8)&255;
-                    break;
-                  case 3:
-                    xc = (m_tmptrns.g&255);
-                    break;
-                  case 4:
-                    xc = (m_tmptrns.b>>8)&255;
-                    break;
-                  case 5:
-                    xc = (m_tmptrns.b&255);
-                    break;
-                  case 6:
-                    xc = (m_tmptrns.a>>8)&255;
-                    break;
-                  case 7:
-                    xc = (m_tmptrns.a&255);
-                    xdiv_xpos++;
-                    break;
-                }
-              }
-            }break;
-          default:
-            xc = m_rand;
-            break;
-          }
-        } else
-          xc = m_rand; 
-        xc&=255;
+        if ((m_row_ready)
+        &&  (xdiv_index < m_row.size()))
+          xc = m_row[xdiv_index];
+        else
+          xc = generate_raw_sample();
         // 
         ch = xc;
         switch (filter_typ)
@@ -982,5 +841,388 @@ namespace cmps3120
     /* TODO fix */
     return ch;
   }
-};
+  unsigned char png_encoder::generate_raw_sample(void)
+  {
+    unsigned char xc = 0;
+    unsigned int i, lv;
+    if (get_receptor() != NULL)
+    {
+      png_receptor *rcpt = get_receptor();
+      png_adam7_data &idta = get_interlace_data();
+      switch (get_header().bit_depth)
+      {
+      case 1:
+        {
+          xc = 0;
+          if (get_header().color_type & PNG_HAS_PALETTE)
+          {
+            for (i = 0; (i < 8)&&(xdiv_xpos<xdiv_width);
+                i++, xdiv_xpos++)
+            {
+             
+              lv = get_palette().closest_match
+                (rcpt->get_pixel
+                  (idta.real_x(xdiv_xpos),idta.real_y(xdiv_ypos),
+                   idta.get_level()), 2);
+              xc |= ((lv&1)<<(7-i));
+            }
+          } else {
+            for (i = 0; (i < 8)&&(xdiv_xpos<xdiv_width);
+                i++, xdiv_xpos++)
+            {
+             
+              lv = (rcpt->get_pixel
+                  (idta.real_x(xdiv_xpos),idta.real_y(xdiv_ypos),
+                   idta.get_level()).gray()>>15);
+              xc |= ((lv&1)<<(7-i));
+            }
+          }
+        }break;
+      case 2:
+        {
+          xc = 0;
+          if (get_header().color_type & PNG_HAS_PALETTE)
+          {
+            for (i = 0; (i < 4)&&(xdiv_xpos<xdiv_width);
+                i++, xdiv_xpos++)
+            {
+             
+              lv = get_palette().closest_match
+                (rcpt->get_pixel
+                  (idta.real_x(xdiv_xpos),idta.real_y(xdiv_ypos),
+                   idta.get_level()), 4);
+              xc |= ((lv&3)<<((3-i)<<1));
+            }
+          } else {
+            for (i = 0; (i < 4)&&(xdiv_xpos<xdiv_width);
+                i++, xdiv_xpos++)
+            {
+             
+              lv = (rcpt->get_pixel
+                  (idta.real_x(xdiv_xpos),idta.real_y(xdiv_ypos),
+                   idta.get_level()).gray()>>14);
+              xc |= ((lv&3)<<((3-i)<<1));
+            }
+          }
+        }break;
+      case 4:
+        {
+          xc = 0;
+          if (get_header().color_type & PNG_HAS_PALETTE)
+          {
+            for (i = 0; (i < 2)&&(xdiv_xpos<xdiv_width);
+                i++, xdiv_xpos++)
+            {
+             
+              lv = get_palette().closest_match
+                (rcpt->get_pixel
+                  (idta.real_x(xdiv_xpos),idta.real_y(xdiv_ypos),
+                   idta.get_level()), 16);
+              xc |= ((lv&15)<<((1-i)<<2));
+            }
+          } else {
+            for (i = 0; (i < 2)&&(xdiv_xpos<xdiv_width);
+                i++, xdiv_xpos++)
+            {
+             
+              lv = (rcpt->get_pixel
+                  (idta.real_x(xdiv_xpos),idta.real_y(xdiv_ypos),
+                   idta.get_level()).gray()>>12);
+              xc |= ((lv&15)<<((1-i)<<2));
+            }
+          }
+        }break;
+      case 8:
+        {
+          if (get_header().color_type == 0)
+          {
+            xc = (rcpt->get_pixel
+                (idta.real_x(xdiv_xpos),idta.real_y(xdiv_ypos),
+                 idta.get_level()).gray()>>8);
+            xdiv_xpos++;
+          } else if (get_header().color_type == 2)
+          {
+            switch (xdiv_index%3)
+            {
+              case 0:
+                m_tmptrns = rcpt->get_pixel
+                  (idta.real_x(xdiv_xpos),idta.real_y(xdiv_ypos),
+                   idta.get_level());
+                xc = m_tmptrns.r>>8;
+                break;
+              case 1:
+                xc = m_tmptrns.g>>8;
+                break;
+              case 2:
+                xc = m_tmptrns.b>>8;
+                xdiv_xpos++;
+                break;
+            }
+          } else if (get_header().color_type == 3)
+          {
+            lv = get_palette().closest_match
+              (rcpt->get_pixel
+                (idta.real_x(xdiv_xpos),idta.real_y(xdiv_ypos),
+                 idta.get_level()), 256);
+            xc = lv;
+            xdiv_xpos++;
+          } else if (get_header().color_type == 4)
+          {
+            switch (xdiv_index%2)
+            {
+              case 0:
+                m_tmptrns = rcpt->get_pixel
+                  (idta.real_x(xdiv_xpos),idta.real_y(xdiv_ypos),
+                   idta.get_level());
+                xc = m_tmptrns.gray()>>8;
+                break;
+              case 1:
+                xc = m_tmptrns.a>>8;
+                xdiv_xpos++;
+                break;
+            }
+          } else if (get_header().color_type == 6)
+          {
+            switch (xdiv_index%4)
+            {
+              case 0:
+                m_tmptrns = rcpt->get_pixel
+                  (idta.real_x(xdiv_xpos),idta.real_y(xdiv_ypos),
+                   idta.get_level());
+                xc = m_tmptrns.r>>8;
+                break;
+              case 1:
+                xc = m_tmptrns.g>>8;
+                break;
+              case 2:
+                xc = m_tmptrns.b>>8;
+                break;
+              case 3:
+                xc = m_tmptrns.a>>8;
+                xdiv_xpos++;
+                break;
+            }
+          }
+        }break;
+      case 16:
+        {
+          if (get_header().color_type == 0)
+          {
+            switch (xdiv_index%2)
+            {
+            case 0:
+              m_tmptrns.r = (rcpt->get_pixel
+                (idta.real_x(xdiv_xpos),idta.real_y(xdiv_ypos),
+                 idta.get_level()).gray());
+              xc = (m_tmptrns.r>>8)&255;
+              break;
+            case 1:
+              xc = (m_tmptrns.r)&255;
+              xdiv_xpos++;
+              break;
+            }
+          } else if (get_header().color_type == 2)
+          {
+            switch (xdiv_index%6)
+            {
+              case 0:
+                m_tmptrns = rcpt->get_pixel
+                  (idta.real_x(xdiv_xpos),idta.real_y(xdiv_ypos),
+                   idta.get_level());
+                xc = (m_tmptrns.r>>8)&255;
+                break;
+              case 1:
+                xc = (m_tmptrns.r&255);
+                break;
+              case 2:
+                xc = (m_tmptrns.g>>8)&255;
+                break;
+              case 3:
+                xc = (m_tmptrns.g&255);
+                break;
+              case 4:
+                xc = (m_tmptrns.b>>8)&255;
+                break;
+              case 5:
+                xc = (m_tmptrns.b&255);
+                xdiv_xpos++;
+                break;
+            }
+          } else if (get_header().color_type == 3)
+          {
+            switch (xdiv_index%2)
+            {
+              case 0:
+                m_tmptrns.r = get_palette().closest_match
+                  (rcpt->get_pixel
+                    (idta.real_x(xdiv_xpos),idta.real_y(xdiv_ypos),
+                    idta.get_level()), 65535);
+                xc = (m_tmptrns.r>>8)&255;
+                break;
+              case 1:
+                xc = (m_tmptrns.r)&255;
+                xdiv_xpos++;
+            }
+          } else if (get_header().color_type == 4)
+          {
+            switch (xdiv_index%4)
+            {
+              case 0:
+                m_tmptrns = rcpt->get_pixel
+                  (idta.real_x(xdiv_xpos),idta.real_y(xdiv_ypos),
+                   idta.get_level());
+                m_tmptrns.r = m_tmptrns.gray();
+                xc = (m_tmptrns.r>>8)&255;
+                break;
+              case 1:
+                xc = (m_tmptrns.r)&255;
+                break;
+              case 2:
+                xc = (m_tmptrns.a>>8)&255;
+                break;
+              case 3:
+                xc = (m_tmptrns.a)&255;
+                xdiv_xpos++;
+                break;
+            }
+          } else if (get_header().color_type == 6)
+          {
+            switch (xdiv_index%8)
+            {
+              case 0:
+                m_tmptrns = rcpt->get_pixel
+                  (idta.real_x(xdiv_xpos),idta.real_y(xdiv_ypos),
+                   idta.get_level());
+                xc = (m_tmptrns.r>>8)&255;
+                break;
+              case 1:
+                xc = m_tmptrns.r&255;
+                break;
+              case 2:
+                xc = (m_tmptrns.g>>8)&255;
+                break;
+              case 3:
+                xc = (m_tmptrns.g&255);
+                break;
+              case 4:
+                xc = (m_tmptrns.b>>8)&255;
+                break;
+              case 5:
+                xc = (m_tmptrns.b&255);
+                break;
+              case 6:
+                xc = (m_tmptrns.a>>8)&255;
+                break;
+              case 7:
+                xc = (m_tmptrns.a&255);
+                xdiv_xpos++;
+                break;
+            }
+          }
+        }break;
+      default:
+        xc = m_rand;
+        break;
+      }
+    } else
+      xc = m_rand; 
+    xc&=255;
+    return xc;
+  }
+
+  unsigned int png_encoder::choose_filter(void) const
+  {
+    return pngenc_choose_filter(m_row.data(), filter_backlog.data(),
+      m_row.size(), filter_dist);
+  }
+
+  int png_encoder::generate_parallel(void)
+  {
+    const unsigned int n = filter_backlog.size(), dist = filter_dist;
+    const unsigned int height = xdiv_height;
+    unsigned int y, b, total;
+    if (!n || !height) return PNG_UNSUPPORTED_HEADER;
+
+    /* the raw rows : from the receptor when it gives them, generated
+     *   one byte at a time otherwise (not thread safe) */
+    std::vector<const unsigned char*> rows(height+1, (const unsigned char*)NULL);
+    png_buffer raw, zero;
+    if (!zero.resize(n)) return PNG_ZSS_ERROR;
+    rows[0] = zero.data();
+    for (y = 0; y < height; y++)
+    {
+      if (get_receptor() != NULL)
+        rows[y+1] = get_receptor()->get_row(y);
+      if (rows[y+1] != NULL)
+        continue;
+      if ((!raw.size()) && (!raw.resize(n*height)))
+        return PNG_ZSS_ERROR;
+      xdiv_ypos = y;
+      xdiv_xpos = 0;
+      for (xdiv_index = 0; xdiv_index < n; xdiv_index++)
+        raw[y*n+xdiv_index] = generate_raw_sample();
+      rows[y+1] = raw.data()+y*n;
+    }
+    xdiv_ypos = height;
+
+    /* bands of about pngenc_band_size bytes, each one preceded by
+     *   the rows filling its 32 KiB dictionary */
+    const unsigned int band_rows = (n+1 < pngenc_band_size)
+      ? pngenc_band_size/(n+1) : 1;
+    const unsigned int dict_rows = (pngenc_dict_size+n)/(n+1);
+    const int nbands = (int)((height+band_rows-1)/band_rows);
+    std::vector<zss_buffer> packed(nbands);
+    std::vector<unsigned long int> adlers(nbands), lengths(nbands);
+    std::vector<int> errors(nbands, 0);
+
+#pragma omp parallel for schedule(dynamic) num_threads(m_threads)
+    for (int band = 0; band < nbands; band++)
+    {
+      unsigned int y0 = band*band_rows, y1 = y0+band_rows, yd, yy, dlen;
+      if (y1 > height) y1 = height;
+      yd = (y0 > dict_rows) ? y0-dict_rows : 0;
+      png_buffer filtered;
+      if (!filtered.resize((y1-yd)*(n+1)))
+      {
+        errors[band] = PNG_ZSS_ERROR;
+        continue;
+      }
+      for (yy = yd; yy < y1; yy++)
+        pngenc_filter_row(rows[yy+1], rows[yy], n, dist,
+          filtered.data()+(yy-yd)*(n+1));
 
+      zenc xband;
+      dlen = (y0-yd)*(n+1);
+      lengths[band] = filtered.size()-dlen;
+      if (xband.put_band(filtered.data(), dlen, filtered.data()+dlen,
+            lengths[band], band+1 == nbands, packed[band]))
+        errors[band] = PNG_ZSS_ERROR;
+      adlers[band] = xband.get_checksum();
+    }
+
+    /* join : zlib header, the bands, checksum of the whole */
+    zss_header xhdr;
+    xhdr.set_check();
+    unsigned int hdr = xhdr;
+    unsigned long int adler = 1;
+    total = 2+4;
+    for (b = 0; b < (unsigned int)nbands; b++)
+    {
+      if (errors[b]) return errors[b];
+      total += packed[b].size();
+    }
+    if (!m_stream.resize(total)) return PNG_ZSS_ERROR;
+    m_stream[0] = (hdr>>8)&255;
+    m_stream[1] = hdr&255;
+    total = 2;
+    for (b = 0; b < (unsigned int)nbands; b++)
+    {
+      memcpy(m_stream.data()+total, packed[b].data(), packed[b].size());
+      total += packed[b].size();
+      adler = zss_checksum::combine(adler, adlers[b], lengths[b]);
+    }
+    for (b = 0; b < 4; b++)
+      m_stream[total+b] = (adler>>((3-b)<<3))&255;
+    return 0;
+  }
+};
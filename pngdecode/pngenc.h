@@ -45,6 +45,18 @@ namespace cmps3120
     png_enc_random& operator=(const png_enc_random& );
   };
 
+  /**
+   * \brief how the encoder filters and compresses
+   */
+  enum png_enc_mode
+  {
+    /** random filter per scanline, simple string matching */
+    png_enc_classic = 0,
+    /** filter with the minimum sum of absolute differences per
+     *  scanline, hash chain string matching with lazy evaluation */
+    png_enc_heuristic = 1
+  };
+
   /**
    * Portable Network Graphics image encoder
    */
@@ -59,6 +71,14 @@ namespace cmps3120
     unsigned int m_pendpos;
     png_pixel m_tmptrns;
     unsigned int m_d_chunk_size;
+    png_enc_mode m_mode;
+    png_buffer m_row;
+    bool m_row_ready;
+    unsigned int m_threads;
+    bool m_parallel;
+    png_buffer m_stream;
+    unsigned int m_stream_pos;
+    const unsigned char* m_chunk;
 
   public:
     /**
@@ -79,6 +99,33 @@ namespace cmps3120
      * @param x the new maximum
      */
     void set_max_dimension(unsigned int x);
+
+    /**
+     * @return the filtering and compression mode
+     */
+    png_enc_mode get_mode(void) const;
+    /**
+     * Set the filtering and compression mode.
+     * @param m the new mode, used from the next write
+     */
+    void set_mode(png_enc_mode m);
+
+    /**
+     * @return the number of threads compressing the image data
+     */
+    unsigned int get_threads(void) const;
+    /**
+     * Set the number of threads compressing the image data. With more
+     *   than one thread, a non interlaced image in png_enc_heuristic
+     *   mode is split in bands of rows, filtered and compressed in
+     *   parallel then joined (sync flush between the bands).
+     * @param n the number of threads, 1 for a single stream
+     * @note more than one thread keeps the rows of
+     *   png_receptor::get_row until the end of the write
+     * @note needs OpenMP, the bands are compressed one after the
+     *   other without it
+     */
+    void set_threads(unsigned int n);
     
     /**
      * Write a file.
@@ -93,6 +140,13 @@ namespace cmps3120
     void reset_sub(void);
     png_error get_byte(unsigned char&);
     int generate_sample(void);
+    unsigned char generate_raw_sample(void);
+    unsigned int choose_filter(void) const;
+    /**
+     * Filter and compress the whole image data in bands.
+     * @return an error code, or zero on success
+     */
+    int generate_parallel(void);
 
   };
 };
@@ -6,6 +6,16 @@
 
 namespace cmps3120
 {
+  /* chain mode parameters */
+  static const unsigned int zenc_window = 32768;
+  static const unsigned int zenc_chain_block = 32768;
+  static const unsigned int zenc_chain_bits = 15;
+  static const unsigned int zenc_max_chain = 32;
+  /* a match this long is taken without looking further */
+  static const unsigned int zenc_nice_length = 64;
+  /* a match this long isn't compared with the next position's */
+  static const unsigned int zenc_max_lazy = 16;
+
   zenc_hash_line::zenc_hash_line(unsigned int *p, unsigned int s)
     : m_dta(p), m_length(s)
   {
@@ -247,7 +257,7 @@ namespace cmps3120
   unsigned int zenc_pair::distance_ext(void) const { return d_ext; }
 
   zenc::zenc(void)
-    : m_d_block_size(1024)
+    : m_match_mode(zenc_match_simple), m_d_block_size(1024)
   {
     reset();
   }
@@ -266,6 +276,103 @@ namespace cmps3120
     m_hashpos = 0;
     m_bithold = 0;
     m_bitcount = 0;
+
+    m_win_len = 0;
+    m_win_pend = 0;
+    m_win_base = 0;
+    m_chain_head.resize(0,0);
+    m_chain_prev.resize(0,0);
+    if (m_match_mode == zenc_match_chain)
+    {
+      m_d_block_size = zenc_chain_block;
+      m_win.resize(zenc_window+zenc_chain_block);
+      m_chain_head.resize(1u<<zenc_chain_bits,1);
+      m_chain_prev.resize(zenc_window,1);
+
+      zss_huffs lengths = zss_huffs::for_fixed();
+      zss_huffs distances = zss_huffs::for_distance();
+      lengths.sort_by_value();
+      distances.sort_by_value();
+      unsigned int v, b;
+      for (v = 0; v < 316; v++)
+      {
+        zss_huff_pair hp = (v < 286)
+          ? lengths.get_bits(v) : distances.get_bits(v-286);
+        zss_huff_pair rev = {0, hp.len};
+        for (b = 0; b < hp.len; b++)
+          rev.bits |= ((hp.bits>>b)&1) << (hp.len-1-b);
+        if (v < 286)
+          m_fixed_lengths[v] = rev;
+        else
+          m_fixed_distances[v-286] = rev;
+      }
+    } else {
+      m_d_block_size = 1024;
+      m_win.resize(0);
+    }
+  }
+  void zenc::set_match_mode(zenc_match_mode m)
+  {
+    m_match_mode = m;
+  }
+  zenc_match_mode zenc::get_match_mode(void) const
+  {
+    return m_match_mode;
+  }
+  zss_error zenc::put_band(const unsigned char* dict, unsigned int dict_len,
+    const unsigned char* dta, unsigned int len, bool last,
+    zss_buffer& out)
+  {
+    int outmode = 0;
+    unsigned int k, n, pos;
+    zenc_match_mode mode = m_match_mode;
+    m_match_mode = zenc_match_chain;
+    reset();
+    m_match_mode = mode;
+
+    if (dict_len > zenc_window)
+    {
+      dict += dict_len-zenc_window;
+      dict_len = zenc_window;
+    }
+    if (dict_len)
+      memcpy(m_win.data(), dict, dict_len);
+    for (k = 0; k+2 < dict_len; k++)
+      insert_chain(k);
+    m_win_len = dict_len;
+
+    out.resize(0);
+    for (pos = 0; (!outmode) && (pos < len); pos += n)
+    {
+      n = len-pos;
+      if (n > m_d_block_size) n = m_d_block_size;
+      memcpy(m_win.data()+m_win_len, dta+pos, n);
+      m_win_pend = n;
+      m_last_block = last && (pos+n >= len);
+      outmode = output_block_chain();
+      if (outmode == ZSS_DONE) outmode = 0;
+
+      if (!last && (pos+n >= len) && !outmode)
+      {
+        /* sync flush : empty stored block, then byte aligned */
+        outmode = push_bits(0, 3);
+        if (!outmode) outmode = push_resync();
+        for (k = 0; (!outmode) && (k < 4); k++)
+          if (!append_no_history(k < 2 ? 0 : 255))
+            outmode = ZSS_MEMORY;
+      } else if (m_last_block && !outmode)
+        outmode = push_resync();
+
+      /* move the pending bytes out, a block at a time */
+      k = out.size();
+      if (!outmode && !out.resize(k+get_pending_count()))
+        outmode = ZSS_MEMORY;
+      if (!outmode && get_pending_count())
+        memcpy(out.data()+k, get_pending().data(), get_pending_count());
+      clear_pending();
+    }
+    if (outmode) set_error((zss_error)outmode);
+    return (zss_error)outmode;
   }
   zss_error zenc::put_char(unsigned char x)
   {
@@ -380,6 +487,21 @@ namespace cmps3120
   int zenc::gen_bits(int x)
   {
     int out = 0;
+    if ((m_match_mode == zenc_match_chain)
+    &&  (get_header().flevel != 0))
+    {
+      if (x >= 0)
+      {
+        m_win[m_win_len+m_win_pend] = x&255;
+        m_win_pend++;
+        if (m_win_pend >= m_d_block_size)
+          out = output_block_chain();
+      } else {
+        m_last_block = true;
+        out = output_block_chain();
+      }
+      return out;
+    }
     if (x >= 0)
     {
       x &= 255;
@@ -484,6 +606,126 @@ namespace cmps3120
     }
     return outmode;
   }
+  int zenc::output_block_chain(void)
+  {
+    int outmode;
+    unsigned int i, k, len, dist, len2, dist2, end, hashed;
+    unsigned char *win;
+    outmode = push_bit(m_last_block?1:0);
+    if (!outmode) outmode = push_bit(1);
+    if (!outmode) outmode = push_bit(0);
+
+    if (!outmode)
+    {
+      win = m_win.data();
+      end = m_win_len+m_win_pend;
+      /* positions before this one are in the hash chains */
+      hashed = m_win_len;
+      for (i = m_win_len; (!outmode) && (i < end); )
+      {
+        len = find_chain_match(i, end, dist);
+        for (; hashed <= i && hashed+2 < end; hashed++)
+          insert_chain(hashed);
+
+        /* lazy matching : a longer match one byte further wins */
+        while (len && len < zenc_max_lazy && i+1 < end)
+        {
+          len2 = find_chain_match(i+1, end, dist2);
+          for (; hashed <= i+1 && hashed+2 < end; hashed++)
+            insert_chain(hashed);
+          if (len2 <= len)
+            break;
+          outmode = push_fixed(win[i]);
+          put_previous(win[i]);
+          i++;
+          len = len2;
+          dist = dist2;
+          if (outmode) break;
+        }
+        if (outmode) break;
+
+        if (len)
+        {
+          outmode = push_fixed(zenc_pair(len,dist));
+          for (k = 0; k < len; k++)
+            put_previous(win[i+k]);
+          i += len;
+          for (; hashed < i && hashed+2 < end; hashed++)
+            insert_chain(hashed);
+        } else {
+          outmode = push_fixed(win[i]);
+          put_previous(win[i]);
+          i++;
+        }
+      }
+
+      if (!outmode)
+        outmode = push_fixed(zenc_pair_stop);
+    }
+
+    /* keep the last 32 KiB as history */
+    end = m_win_len+m_win_pend;
+    if (end > zenc_window)
+    {
+      memmove(m_win.data(), m_win.data()+(end-zenc_window), zenc_window);
+      m_win_base += end-zenc_window;
+      m_win_len = zenc_window;
+    } else m_win_len = end;
+    m_win_pend = 0;
+
+    m_has_blocks = true;
+    if (m_last_block && !outmode) outmode = ZSS_DONE;
+    return outmode;
+  }
+  unsigned int zenc::chain_hash(unsigned int k) const
+  {
+    const unsigned char *win = m_win.data()+k;
+    return ((win[0]<<10)^(win[1]<<5)^win[2])&((1u<<zenc_chain_bits)-1);
+  }
+  void zenc::insert_chain(unsigned int k)
+  {
+    unsigned int *head = &m_chain_head.at(0);
+    unsigned int *prev = &m_chain_prev.at(0);
+    unsigned int h = chain_hash(k), pos = m_win_base+k;
+    prev[pos&(zenc_window-1)] = head[h];
+    head[h] = pos+1;
+  }
+  unsigned int zenc::find_chain_match
+    (unsigned int k, unsigned int end, unsigned int& dist)
+  {
+    const unsigned int *head = &m_chain_head.at(0);
+    const unsigned int *prev = &m_chain_prev.at(0);
+    const unsigned char *win = m_win.data();
+    unsigned int cur = m_win_base+k, best = 0, len, chain, cand, p;
+    unsigned int maxlen = end-k;
+    if (maxlen > 258) maxlen = 258;
+    if (maxlen < 3) return 0;
+
+    cand = head[chain_hash(k)];
+    for (chain = zenc_max_chain; cand && chain; chain--)
+    {
+      p = cand-1;
+      /* out of the window (the chain only goes back in time) */
+      if ((p >= cur) || (cur-p > zenc_window) || (p < m_win_base))
+        break;
+      const unsigned char *a = win+(p-m_win_base), *b = win+k;
+      if ((a[best] == b[best]) && (a[0] == b[0]) && (a[1] == b[1]))
+      {
+        for (len = 2; len < maxlen && a[len] == b[len]; len++)
+          ;
+        if (len > best && len >= 3)
+        {
+          best = len;
+          dist = cur-p;
+          if (best >= zenc_nice_length || best >= maxlen)
+            break;
+        }
+      }
+      cand = prev[p&(zenc_window-1)];
+      if (cand > p) break;
+    }
+    return best;
+  }
   int zenc::push_bit(int x)
   {
     m_bithold = (m_bithold)|((x?1:0)<<m_bitcount);
@@ -496,6 +738,38 @@ namespace cmps3120
     }
     return 0;
   }
+  int zenc::push_bits(unsigned long int bits, unsigned int count)
+  {
+    m_bithold |= (int)(bits << m_bitcount);
+    m_bitcount += count;
+    while (m_bitcount >= 8)
+    {
+      if (!append_no_history(m_bithold&255)) return ZSS_MEMORY;
+      m_bithold >>= 8;
+      m_bitcount -= 8;
+    }
+    return 0;
+  }
+  int zenc::push_fixed(const zenc_pair& ndv)
+  {
+    int out;
+    unsigned int l;
+    const zss_huff_pair& hp = m_fixed_lengths[ndv.length()];
+    out = push_bits(hp.bits, hp.len);
+    if (out || ndv.length() <= 256)
+      return out;
+
+    l = (ndv.length() < 261 || ndv.length() == 285)
+      ? 0 : (ndv.length()-261)>>2;
+    if (l) out = push_bits(ndv.length_ext(), l);
+
+    const zss_huff_pair& dp = m_fixed_distances[ndv.distance()];
+    if (!out) out = push_bits(dp.bits, dp.len);
+
+    l = (ndv.distance() < 2) ? 0 : (ndv.distance()-2)>>1;
+    if (!out && l) out = push_bits(ndv.distance_ext(), l);
+    return out;
+  }
   int zenc::push_resync(void)
   {
     if (m_bitcount)
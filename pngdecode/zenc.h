@@ -209,6 +209,18 @@ namespace cmps3120
     unsigned int distance_ext(void) const;
   };
 
+  /**
+   * \brief how the encoder looks for repeated strings
+   */
+  enum zenc_match_mode
+  {
+    /** a few recent positions per 3-byte sum, 1 KiB blocks */
+    zenc_match_simple = 0,
+    /** hash chains over the whole 32 KiB window with lazy
+     *  matching, 32 KiB blocks */
+    zenc_match_chain = 1
+  };
+
   class zenc : public zss
   {
   public:
@@ -217,7 +229,39 @@ namespace cmps3120
 
     void reset(void);
 
+    /**
+     * Choose the string matching. Kept across reset().
+     * @param m the new mode, takes effect at the next reset
+     */
+    void set_match_mode(zenc_match_mode m);
+    /**
+     * @return the string matching mode
+     */
+    zenc_match_mode get_match_mode(void) const;
+
+    /**
+     * Compress one band of a stream split for parallel encoding.
+     *   The output is raw deflate data, without the zlib header
+     *   nor the checksum : the bands are joined by concatenation.
+     *   Hash chains are used whatever the match mode.
+     * @param dict the bytes preceding the band in the whole stream,
+     *   used as history (up to the last 32 KiB), or NULL
+     * @param dict_len the number of bytes in dict
+     * @param dta the bytes of the band
+     * @param len the number of bytes in the band
+     * @param last whether the band ends the stream. If not, the band
+     *   ends with a sync flush (empty stored block) on a byte boundary.
+     * @param[out] out receives the compressed band
+     * @return an error code, or zero on success. get_checksum() is
+     *   then the checksum of the band alone.
+     * @note resets the encoder
+     */
+    zss_error put_band(const unsigned char* dict, unsigned int dict_len,
+      const unsigned char* dta, unsigned int len, bool last,
+      zss_buffer& out);
+
   private:
+    zenc_match_mode m_match_mode;
     unsigned int m_d_block_size;
     zss_buffer m_bytes_pend;
     bool m_last_block;
@@ -229,12 +273,38 @@ namespace cmps3120
     unsigned int m_hashpos;
     zenc_hash m_hash;
 
+    /* chain mode : the last 32 KiB of history followed by the
+     *   pending block, absolute position of m_win[0] */
+    zss_buffer m_win;
+    unsigned int m_win_len;
+    unsigned int m_win_pend;
+    unsigned int m_win_base;
+    /* most recent position + 1 of each hash value, and
+     *   previous position with the same hash of each position */
+    zenc_hash m_chain_head;
+    zenc_hash m_chain_prev;
+    /* fixed codes, bits reversed : pushed at once */
+    zss_huff_pair m_fixed_lengths[286];
+    zss_huff_pair m_fixed_distances[30];
+
     zss_error put_char(unsigned char x);
     zss_error put_eof(void);
     zss_error put_char_or_eof(int );
     int gen_bits(int x);
     int output_block(void);
+    int output_block_chain(void);
     int push_bit(int B);
+    /**
+     * Push several bits at once, least significant first.
+     * @param bits the bits to push
+     * @param count the number of bits, at most 16
+     */
+    int push_bits(unsigned long int bits, unsigned int count);
+    /**
+     * Chain mode equivalent of augmented_push_bit, with the
+     *   fixed codes tables.
+     */
+    int push_fixed(const zenc_pair& ndv);
     int push_resync(void);
     void next_hash(unsigned char x);
 
@@ -244,6 +314,21 @@ namespace cmps3120
      *   a skip code is not vailable
      */
     unsigned int try_hash(unsigned int curs);
+
+    /**
+     * @param k a position in the chain window
+     * @param end the end of the bytes available to a match
+     * @param dist receives the distance of the match
+     * @return the length of the longest match found, or zero
+     */
+    unsigned int find_chain_match(unsigned int k, unsigned int end,
+      unsigned int& dist);
+    /**
+     * Add a chain window position to the hash chains.
+     * @param k a position with at least 3 bytes available
+     */
+    void insert_chain(unsigned int k);
+    unsigned int chain_hash(unsigned int k) const;
     
     /**
      * @param curs the current position in the input bytes pending buffer
@@ -55,6 +55,7 @@ namespace cmps3120
           m_entries = NULL;
         }
         m_count = 0;
+        m_alloc = 0;
         m_sort = 0;
       }
       return *this;
@@ -106,6 +107,7 @@ namespace cmps3120
           m_entries = NULL;
         }
         m_count = 0;
+        m_alloc = 0;
         m_sort = 0;
       }
       return true;
@@ -394,6 +396,22 @@ namespace cmps3120
     {
       return ((unsigned long int)xva)|(((unsigned long int)xvb)<<16);
     }
+    unsigned long int zss_checksum::combine
+      (unsigned long int a, unsigned long int b, unsigned long int len_b)
+    {
+      /* each byte of the second part adds the first sum of the
+       *   first part once more to the second sum */
+      const unsigned long int base = 65521UL;
+      unsigned long int rem = len_b % base;
+      unsigned long int sa = a&65535, sb = (rem*sa) % base;
+      sa += (b&65535) + base - 1;
+      sb += ((a>>16)&65535) + ((b>>16)&65535) + base - rem;
+      if (sa >= base) sa -= base;
+      if (sa >= base) sa -= base;
+      if (sb >= (base<<1)) sb -= (base<<1);
+      if (sb >= base) sb -= base;
+      return sa|(sb<<16);
+    }
 
 
 
@@ -175,6 +175,16 @@ namespace cmps3120
     zss_checksum(unsigned long int l = 1UL);
     zss_checksum& add(unsigned char ch);
     operator unsigned long int(void) const;
+
+    /**
+     * Checksum of two concatenated byte sequences.
+     * @param a the checksum of the first sequence
+     * @param b the checksum of the second sequence
+     * @param len_b the length of the second sequence
+     * @return the checksum of the whole
+     */
+    static unsigned long int combine
+      (unsigned long int a, unsigned long int b, unsigned long int len_b);
   };
   
   /**
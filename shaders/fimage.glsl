@@ -0,0 +1,15 @@
+#version 150
+
+uniform sampler2D Image;   // sum of the samples of every pixel
+uniform float     Passes;  // number of samples in the sum
+
+in  vec2 texCoord;
+out vec4 fragColor;
+
+void main() 
+{ 
+  vec3 color = texture(Image, texCoord).rgb / Passes;
+  
+  // Gamma correction : 2, as in the png
+  fragColor = vec4(sqrt(color), 1.0);
+}
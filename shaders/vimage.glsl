@@ -0,0 +1,13 @@
+#version 150
+
+out vec2 texCoord;
+
+void main() 
+{
+  // full screen triangle made from the vertex id, no vertex buffer
+  vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+  
+  // first row of the ray traced image is the top of the window
+  texCoord = vec2(p.x, 1.0 - p.y);
+  gl_Position = vec4(2.0 * p - 1.0, 0.0, 1.0);
+}
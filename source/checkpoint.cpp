@@ -0,0 +1,181 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  --- checkpoint.cpp ---
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "checkpoint.h"
+
+// Checkpoint file : header, one byte per tile (finished or not), then the
+// sums (and rays per pixel when adaptive) of the finished tiles, row by row
+struct CheckpointHeader{
+    char magic[4];
+    unsigned int version;
+    unsigned long long fingerprint;
+    int width, height, tileSize, ntiles;
+};
+
+static const char checkpointMagic[4] = { 'R', 'T', 'C', 'K' };
+static const unsigned int checkpointVersion = 2;
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+RenderCheckpoint::RenderCheckpoint(const CheckpointSettings& settings, const Camera& camera, int tileSize,
+                                   float* accum, unsigned int* counts)
+    : settings(settings), width(camera.getWidth()), height(camera.getHeight()), tileSize(tileSize),
+      accum(accum), counts(counts), saving(false), lastSave(std::chrono::steady_clock::now()){
+    this->settings.interval = (std::max)(settings.interval, minCheckpointInterval);
+    ntilesX = (width + tileSize - 1) / tileSize;
+    ntiles  = ntilesX * ((height + tileSize - 1) / tileSize);
+    done.assign(ntiles, 0);
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+void RenderCheckpoint::tileRect(int tile, int& x0, int& y0, int& x1, int& y1) const{
+    x0 = (tile % ntilesX) * tileSize;
+    y0 = (tile / ntilesX) * tileSize;
+    x1 = (std::min)(x0 + tileSize, width);
+    y1 = (std::min)(y0 + tileSize, height);
+}
+
+/* -------------------------------------------------------------------------- */
+/* ------  FNV-1a of everything that changes the image : a checkpoint  ------ */
+/* ------  of another render is never resumed                          ------ */
+unsigned long long RenderCheckpoint::fingerprint() const{
+    unsigned long long h = 0xcbf29ce484222325ull;
+    auto add = [&h](const void* data, size_t size){
+        const unsigned char* bytes = (const unsigned char*)data;
+        for (size_t k = 0; k < size; k++) { h = (h ^ bytes[k]) * 0x100000001b3ull; }
+    };
+    const RenderSettings& s = renderSettings;
+    int flags[3] = { s.roulette ? 1 : 0, (int)s.pixelPattern, (int)s.lightPattern };
+    add(&width, sizeof(width));
+    add(&height, sizeof(height));
+    add(&s.nraysample, sizeof(s.nraysample));
+    add(&s.nshadowsample, sizeof(s.nshadowsample));
+    add(&s.nshadowbatch, sizeof(s.nshadowbatch));
+    add(&s.maxDepth, sizeof(s.maxDepth));
+    add(&s.seed, sizeof(s.seed));
+    add(&s.minThroughput, sizeof(s.minThroughput));
+    add(flags, sizeof(flags));
+    add(&s.nminsample, sizeof(s.nminsample));
+    add(&s.noiseThreshold, sizeof(s.noiseThreshold));
+    add(settings.job.data(), settings.job.size());
+    return h;
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+bool RenderCheckpoint::load(){
+    FILE * file = fopen(settings.path.c_str(), "rb");
+    if (file == NULL) { return false; }
+
+    CheckpointHeader header;
+    bool valid = fread(&header, sizeof(header), 1, file) == 1
+              && memcmp(header.magic, checkpointMagic, 4) == 0
+              && header.version == checkpointVersion
+              && header.fingerprint == fingerprint()
+              && header.width == width && header.height == height
+              && header.tileSize == tileSize && header.ntiles == ntiles;
+
+    std::vector < char > saved(ntiles, 0);
+    valid = valid && fread(&saved[0], 1, ntiles, file) == (size_t)ntiles;
+
+    for (int tile = 0; valid && tile < ntiles; tile++) {
+        if (!saved[tile]) { continue; }
+        int x0, y0, x1, y1;
+        tileRect(tile, x0, y0, x1, y1);
+        const size_t n = x1 - x0;
+        for (int j = y0; valid && j < y1; j++) {
+            valid = fread(&accum[3 * ((size_t)j * width + x0)], sizeof(float), 3 * n, file) == 3 * n;
+            if (valid && counts != NULL) {
+                valid = fread(&counts[(size_t)j * width + x0], sizeof(unsigned int), n, file) == n;
+            }
+        }
+    }
+    fclose(file);
+
+    if (!valid) {
+        std::cerr << settings.path << " is not a checkpoint of this render." << std::endl;
+        std::fill(accum, accum + 3 * (size_t)width * height, 0.0f);
+        return false;
+    }
+    done = saved;
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+/* ------  Without the mutex : the sums of finished tiles aren't        ----- */
+/* ------  written anymore, the others aren't read                      ----- */
+bool RenderCheckpoint::save(const std::vector < char >& finished){
+    const std::string temporary = settings.path + ".tmp";
+    FILE * file = fopen(temporary.c_str(), "wb");
+    if (file == NULL) {
+        std::cerr << "can't write checkpoint " << temporary << "." << std::endl;
+        return false;
+    }
+
+    CheckpointHeader header;
+    memcpy(header.magic, checkpointMagic, 4);
+    header.version = checkpointVersion;
+    header.fingerprint = fingerprint();
+    header.width = width;
+    header.height = height;
+    header.tileSize = tileSize;
+    header.ntiles = ntiles;
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1
+                && fwrite(&finished[0], 1, ntiles, file) == (size_t)ntiles;
+
+    for (int tile = 0; written && tile < ntiles; tile++) {
+        if (!finished[tile]) { continue; }
+        int x0, y0, x1, y1;
+        tileRect(tile, x0, y0, x1, y1);
+        const size_t n = x1 - x0;
+        for (int j = y0; written && j < y1; j++) {
+            written = fwrite(&accum[3 * ((size_t)j * width + x0)], sizeof(float), 3 * n, file) == 3 * n;
+            if (written && counts != NULL) {
+                written = fwrite(&counts[(size_t)j * width + x0], sizeof(unsigned int), n, file) == n;
+            }
+        }
+    }
+    written = (fclose(file) == 0) && written;
+
+#if defined(_WIN32)
+    // rename doesn't replace an existing file on Windows
+    remove(settings.path.c_str());
+#endif
+    if (!written || rename(temporary.c_str(), settings.path.c_str()) != 0) {
+        std::cerr << "can't write checkpoint " << settings.path << "." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+void RenderCheckpoint::tileFinished(int tile){
+    std::vector < char > finished;
+    {
+        std::lock_guard < std::mutex > lock(mutex);
+        done[tile] = 1;
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (saving || std::chrono::duration < double >(now - lastSave).count() < settings.interval) { return; }
+        // the other threads go on rendering while this one writes
+        saving = true;
+        lastSave = now;
+        finished = done;
+    }
+
+    save(finished);
+
+    std::lock_guard < std::mutex > lock(mutex);
+    saving = false;
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+int RenderCheckpoint::finishedTiles() const{
+    return (int)std::count(done.begin(), done.end(), 1);
+}
@@ -0,0 +1,62 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  --- checkpoint.h ---
+//
+//  Checkpoints of a long rayTrace : the finished tiles (their accumulated
+//  samples and, when adaptive, the rays of every pixel) are saved every few
+//  seconds. A resumed render only traces the other tiles. The random streams
+//  only depend on (seed, pixel, sample) and a tile always adds all its
+//  samples to zeroed sums, so the final image is the same, bit for bit, as
+//  the one of an uninterrupted render.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef __CHECKPOINT_H__
+#define __CHECKPOINT_H__
+
+#include "raytrace.h"
+#include <mutex>
+#include <chrono>
+
+class RenderCheckpoint{
+public:
+
+    // accum (3 floats per pixel) and counts (NULL if not adaptive) are the
+    // buffers of the render, tiles of tileSize pixels in the order of renderTiles
+    RenderCheckpoint(const CheckpointSettings& settings, const Camera& camera, int tileSize,
+                     float* accum, unsigned int* counts);
+
+    // Restores the tiles saved in settings.path. False if there is no file,
+    // or if it belongs to another render (image, settings or job).
+    bool load();
+
+    // Only called before the render or by the thread rendering the tile
+    bool finished(int tile) const { return done[tile] != 0; }
+
+    // Marks tile as finished, saves if the interval has elapsed
+    void tileFinished(int tile);
+
+    // not while rendering
+    int finishedTiles() const;
+
+private:
+
+    // Saves the tiles flagged in finished, written to a temporary file then
+    // renamed : a killed process leaves the previous checkpoint intact
+    bool save(const std::vector < char >& finished);
+
+    void tileRect(int tile, int& x0, int& y0, int& x1, int& y1) const;
+    unsigned long long fingerprint() const;
+
+    CheckpointSettings settings;
+    int width, height, tileSize, ntilesX, ntiles;
+    float* accum;
+    unsigned int* counts;
+
+    std::mutex mutex; // done, saving and lastSave
+    std::vector < char > done;
+    bool saving;      // a thread is writing the file
+    std::chrono::steady_clock::time_point lastSave;
+};
+
+#endif // __CHECKPOINT_H__
@@ -0,0 +1,187 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  --- BVH.cpp ---
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "common.h"
+
+namespace {
+
+// Binned SAH parameters
+const int    nBins         = 16;
+const double traversalCost = 1.0;   // relative to one primitive intersection
+
+// Past this depth fall back to median splits so that the traversal stack stays bounded
+const int    maxSAHDepth   = 40;
+
+// Flat boxes (squares) get a small thickness so that slab tests stay robust
+const float  boxPadding    = 1e-5f;
+
+struct Bounds{
+    vec3 bmin;
+    vec3 bmax;
+
+    Bounds(): bmin((std::numeric_limits< float >::max)(),
+                   (std::numeric_limits< float >::max)(),
+                   (std::numeric_limits< float >::max)()),
+              bmax(-(std::numeric_limits< float >::max)(),
+                   -(std::numeric_limits< float >::max)(),
+                   -(std::numeric_limits< float >::max)()) {}
+
+    void expand(const vec3& pmin, const vec3& pmax){
+        bmin = vec3((std::min)(bmin.x, pmin.x), (std::min)(bmin.y, pmin.y), (std::min)(bmin.z, pmin.z));
+        bmax = vec3((std::max)(bmax.x, pmax.x), (std::max)(bmax.y, pmax.y), (std::max)(bmax.z, pmax.z));
+    }
+
+    void expand(const Bounds& b){ expand(b.bmin, b.bmax); }
+
+    double area() const{
+        if (bmax.x < bmin.x) { return 0.0; }
+        vec3 d = bmax - bmin;
+        return 2.0 * ((double)d.x * d.y + (double)d.y * d.z + (double)d.z * d.x);
+    }
+};
+
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+void BVH::build(const std::vector < vec3 >& primMin, const std::vector < vec3 >& primMax, int maxLeafSize){
+    clear();
+
+    const int n = (int)primMin.size();
+    if (n == 0) { return; }
+
+    std::vector < vec3 > centroids(n);
+    primIndices.resize(n);
+    for (int i = 0; i < n; i++) {
+        primIndices[i] = i;
+        centroids[i] = (primMin[i] + primMax[i]) * 0.5f;
+    }
+
+    // a binary tree over n leaves never needs more than 2n-1 nodes
+    nodes.reserve(2 * n - 1);
+    buildNode(0, n, 0, maxLeafSize, primMin, primMax, centroids);
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+int BVH::buildNode(int first, int count, int depth, int maxLeafSize,
+                   const std::vector < vec3 >& primMin, const std::vector < vec3 >& primMax,
+                   const std::vector < vec3 >& centroids){
+
+    const int nodeIdx = (int)nodes.size();
+    nodes.push_back(Node());
+
+    Bounds bounds, centroidBounds;
+    for (int i = first; i < first + count; i++) {
+        unsigned int p = primIndices[i];
+        bounds.expand(primMin[p], primMax[p]);
+        centroidBounds.expand(centroids[p], centroids[p]);
+    }
+
+    vec3 pad(boxPadding, boxPadding, boxPadding);
+    nodes[nodeIdx].box_min = bounds.bmin - pad;
+    nodes[nodeIdx].box_max = bounds.bmax + pad;
+    nodes[nodeIdx].axis = 0;
+
+    // largest centroid extent
+    vec3 extent = centroidBounds.bmax - centroidBounds.bmin;
+    int axis = 0;
+    if (extent.y > extent[axis]) { axis = 1; }
+    if (extent.z > extent[axis]) { axis = 2; }
+
+    if (count == 1 || extent[axis] <= 0.0f) {
+        // single primitive or all centroids at the same place : can't split
+        nodes[nodeIdx].offset = first;
+        nodes[nodeIdx].count  = count;
+        return nodeIdx;
+    }
+
+    int mid = -1;
+
+    if (depth < maxSAHDepth) {
+        // Binned SAH over the three axes
+        double bestCost = std::numeric_limits< double >::infinity();
+        int bestAxis = -1, bestSplit = -1;
+
+        for (int a = 0; a < 3; a++) {
+            if (extent[a] <= 0.0f) { continue; }
+
+            Bounds bins[nBins];
+            int binCount[nBins] = { 0 };
+            double scale = nBins / (double)extent[a];
+            for (int i = first; i < first + count; i++) {
+                unsigned int p = primIndices[i];
+                int b = (int)((centroids[p][a] - centroidBounds.bmin[a]) * scale);
+                b = (std::min)(b, nBins - 1);
+                binCount[b]++;
+                bins[b].expand(primMin[p], primMax[p]);
+            }
+
+            // sweep from the right to get the area of every right hand side
+            double rightArea[nBins];
+            int rightCount[nBins];
+            Bounds acc;
+            int accCount = 0;
+            for (int b = nBins - 1; b > 0; b--) {
+                acc.expand(bins[b]);
+                accCount += binCount[b];
+                rightArea[b]  = acc.area();
+                rightCount[b] = accCount;
+            }
+
+            acc = Bounds();
+            accCount = 0;
+            for (int b = 0; b < nBins - 1; b++) {
+                acc.expand(bins[b]);
+                accCount += binCount[b];
+                if (accCount == 0 || rightCount[b + 1] == 0) { continue; }
+                double cost = acc.area() * accCount + rightArea[b + 1] * rightCount[b + 1];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = a;
+                    bestSplit = b;
+                }
+            }
+        }
+
+        double leafCost = (double)count;
+        double area = bounds.area();
+        bestCost = area > 0.0 ? traversalCost + bestCost / area : bestCost;
+
+        if (bestAxis == -1 || (count <= maxLeafSize && bestCost >= leafCost)) {
+            if (count <= maxLeafSize) {
+                nodes[nodeIdx].offset = first;
+                nodes[nodeIdx].count  = count;
+                return nodeIdx;
+            }
+        }
+        else {
+            double scale = nBins / (double)extent[bestAxis];
+            double lo = centroidBounds.bmin[bestAxis];
+            unsigned int *split = std::partition(&primIndices[first], &primIndices[first] + count,
+                [&](unsigned int p){
+                    int b = (int)((centroids[p][bestAxis] - lo) * scale);
+                    return (std::min)(b, nBins - 1) <= bestSplit;
+                });
+            mid = (int)(split - &primIndices[0]);
+            axis = bestAxis;
+        }
+    }
+
+    if (mid <= first || mid >= first + count) {
+        // median split along the largest extent
+        mid = first + count / 2;
+        std::nth_element(&primIndices[first], &primIndices[mid], &primIndices[first] + count,
+            [&](unsigned int p, unsigned int q){ return centroids[p][axis] < centroids[q][axis]; });
+    }
+
+    nodes[nodeIdx].axis  = axis;
+    nodes[nodeIdx].count = 0;
+    buildNode(first, mid - first, depth + 1, maxLeafSize, primMin, primMax, centroids);
+    nodes[nodeIdx].offset = buildNode(mid, first + count - mid, depth + 1, maxLeafSize, primMin, primMax, centroids);
+
+    return nodeIdx;
+}
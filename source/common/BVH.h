@@ -0,0 +1,107 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  --- BVH.h ---
+//
+//  Bounding volume hierarchy built with the surface area heuristic and
+//  flattened into a linear array of nodes (depth first : the left child of
+//  an interior node is always the next node in the array).
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef __BVH_H__
+#define __BVH_H__
+
+#include "common.h"
+
+class BVH{
+public:
+
+    typedef struct{
+        vec3 box_min;
+        vec3 box_max;
+        int offset;   // leaf : first entry in primIndices, interior : index of right child
+        int count;    // number of primitives, 0 for interior nodes
+        int axis;     // split axis of interior nodes
+    } Node;
+
+    std::vector < Node > nodes;
+    std::vector < unsigned int > primIndices;
+
+    // Build over primitives given by their world space boxes
+    void build(const std::vector < vec3 >& primMin, const std::vector < vec3 >& primMax, int maxLeafSize=4);
+
+    void clear(){ nodes.clear(); primIndices.clear(); }
+    bool empty() const { return nodes.empty(); }
+
+    // Visit the leaves whose boxes are pierced by p0 + t*V, t in [0, tmax].
+    // leafTest(first, count) receives the leaf's range in primIndices, it may
+    // shrink tmax (closest hit queries) and returns true to stop the traversal.
+    template < class LeafTest >
+    void traverseLeaves(const vec4& p0, const vec4& V, const double& tmax, LeafTest leafTest) const{
+        if (nodes.empty()) { return; }
+
+        const double invD[3] = { 1.0 / V.x, 1.0 / V.y, 1.0 / V.z };
+        const int dirNeg[3]  = { invD[0] < 0.0, invD[1] < 0.0, invD[2] < 0.0 };
+
+        int stack[64];
+        int sp = 0;
+        int current = 0;
+
+        while (true) {
+            const Node& node = nodes[current];
+            if (hitBox(node, p0, invD, tmax)) {
+                if (node.count > 0) {
+                    if (leafTest(node.offset, node.count)) { return; }
+                    if (sp == 0) { break; }
+                    current = stack[--sp];
+                }
+                else if (dirNeg[node.axis]) {
+                    // visit the near child first
+                    stack[sp++] = current + 1;
+                    current = node.offset;
+                }
+                else {
+                    stack[sp++] = node.offset;
+                    current = current + 1;
+                }
+            }
+            else {
+                if (sp == 0) { break; }
+                current = stack[--sp];
+            }
+        }
+    }
+
+    // Same, one primitive at a time : leafTest(prim) gets indices of the
+    // original primitive list
+    template < class LeafTest >
+    void traverse(const vec4& p0, const vec4& V, const double& tmax, LeafTest leafTest) const{
+        traverseLeaves(p0, V, tmax, [&](int first, int count){
+            for (int k = 0; k < count; k++) {
+                if (leafTest(primIndices[first + k])) { return true; }
+            }
+            return false;
+        });
+    }
+
+private:
+
+    static bool hitBox(const Node& node, const vec4& p0, const double invD[3], double tmax){
+        double tmin = 0.0;
+        for (int a = 0; a < 3; a++) {
+            double t0 = (node.box_min[a] - p0[a]) * invD[a];
+            double t1 = (node.box_max[a] - p0[a]) * invD[a];
+            if (invD[a] < 0.0) { std::swap(t0, t1); }
+            tmin = t0 > tmin ? t0 : tmin;
+            tmax = t1 < tmax ? t1 : tmax;
+            if (tmax < tmin) { return false; }
+        }
+        return true;
+    }
+
+    int buildNode(int first, int count, int depth, int maxLeafSize,
+                  const std::vector < vec3 >& primMin, const std::vector < vec3 >& primMax,
+                  const std::vector < vec3 >& centroids);
+};
+
+#endif // __BVH_H__
@@ -0,0 +1,72 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  --- Camera.cpp ---
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "common.h"
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+void Camera::setup(const mat4& modelView, const mat4& projection, int width, int height){
+    this->width = width;
+    this->height = height;
+
+    // Same conventions as _gluUnProject : column major arrays
+    GLdouble modelViewMatrix[16];
+    GLdouble projectionMatrix[16];
+    for(unsigned int i=0; i < 4; i++){
+        for(unsigned int j=0; j < 4; j++){
+            modelViewMatrix[j*4+i]  =  modelView[i][j];
+            projectionMatrix[j*4+i] =  projection[i][j];
+        }
+    }
+
+    GLdouble finalMatrix[16];
+    __gluMultMatricesd(modelViewMatrix, projectionMatrix, finalMatrix);
+    if (!__gluInvertMatrixd(finalMatrix, finalMatrix)) {
+        std::cerr << "Camera : singular projection * modelview matrix." << std::endl;
+    }
+
+    // Window (x, y) maps to normalized device coordinates
+    // ( 2x/width - 1, 1 - 2y/height, -1 or 1 )
+    GLdouble ndcNear[4] = { -1.0, 1.0, -1.0, 1.0 };
+    GLdouble ndcFar[4]  = { -1.0, 1.0,  1.0, 1.0 };
+    __gluMultMatrixVecd(finalMatrix, ndcNear, nearOrigin);
+    __gluMultMatrixVecd(finalMatrix, ndcFar, farOrigin);
+
+    for (int k = 0; k < 4; k++) {
+        dx[k] =  2.0 / width  * finalMatrix[0*4+k];
+        dy[k] = -2.0 / height * finalMatrix[1*4+k];
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+void Camera::generateRay(double x, double y, vec4& origin, vec4& dir) const{
+    double n[4], f[4];
+    for (int k = 0; k < 4; k++) {
+        n[k] = nearOrigin[k] + x * dx[k] + y * dy[k];
+        f[k] = farOrigin[k]  + x * dx[k] + y * dy[k];
+    }
+
+    double nx = n[0] / n[3], ny = n[1] / n[3], nz = n[2] / n[3];
+    double fx = f[0] / f[3] - nx, fy = f[1] / f[3] - ny, fz = f[2] / f[3] - nz;
+    double len = std::sqrt(fx*fx + fy*fy + fz*fz);
+
+    origin = vec4(nx, ny, nz, 1.0);
+    dir = vec4(fx / len, fy / len, fz / len, 0.0);
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+bool Camera::operator==(const Camera& other) const{
+    if (width != other.width || height != other.height) { return false; }
+    for (int k = 0; k < 4; k++) {
+        if (nearOrigin[k] != other.nearOrigin[k] || farOrigin[k] != other.farOrigin[k] ||
+            dx[k] != other.dx[k] || dy[k] != other.dy[k]) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,53 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  --- Camera.h ---
+//
+//  Primary ray generator. The inverse of projection*modelview is computed
+//  once in setup(); since unprojection is linear before the perspective
+//  divide, the near and far points of any window position are then found
+//  from the pixel (0,0) points and two per-pixel deltas.
+//  No GL call is made : rays can be generated from any thread.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef __CAMERA_H__
+#define __CAMERA_H__
+
+#include "common.h"
+
+class Camera{
+public:
+
+    Camera(): width(0), height(0) {}
+
+    Camera(const mat4& modelView, const mat4& projection, int width, int height){
+        setup(modelView, projection, width, height);
+    }
+
+    // width x height is the viewport in pixels, origin in the top left corner
+    void setup(const mat4& modelView, const mat4& projection, int width, int height);
+
+    // Ray through window position (x, y) (y going down, as glfw cursor positions)
+    // origin is on the near plane, dir is normalized with w = 0
+    void generateRay(double x, double y, vec4& origin, vec4& dir) const;
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    // same viewport and same rays
+    bool operator==(const Camera& other) const;
+    bool operator!=(const Camera& other) const { return !(*this == other); }
+
+private:
+    int width;
+    int height;
+
+    // homogeneous world space points of window position (0,0) on the near/far planes
+    double nearOrigin[4];
+    double farOrigin[4];
+    // homogeneous offsets for one pixel along x and y
+    double dx[4];
+    double dy[4];
+};
+
+#endif // __CAMERA_H__
@@ -0,0 +1,90 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  --- MappedFile.cpp ---
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+#if defined(_WIN32)
+MappedFile::MappedFile(): bytes(NULL), length(0), file(INVALID_HANDLE_VALUE), mapping(NULL) {}
+#else
+MappedFile::MappedFile(): bytes(NULL), length(0), fd(-1) {}
+#endif
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+bool MappedFile::open(const char* path){
+    close();
+
+#if defined(_WIN32)
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) { return false; }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) { close(); return false; }
+    length = (size_t)fileSize.QuadPart;
+    if (length == 0) { return true; }
+
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL) { close(); return false; }
+    bytes = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (bytes == NULL) { close(); return false; }
+#else
+    fd = ::open(path, O_RDONLY);
+    if (fd < 0) { return false; }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) { close(); return false; }
+    length = (size_t)st.st_size;
+    if (length == 0) { return true; }
+
+    void* view = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (view == MAP_FAILED) { close(); return false; }
+    bytes = (const unsigned char*)view;
+    // read front to back
+    madvise(view, length, MADV_SEQUENTIAL);
+#endif
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+void MappedFile::close(){
+#if defined(_WIN32)
+    if (bytes != NULL) { UnmapViewOfFile(bytes); }
+    if (mapping != NULL) { CloseHandle(mapping); }
+    if (file != INVALID_HANDLE_VALUE) { CloseHandle(file); }
+    mapping = NULL;
+    file = INVALID_HANDLE_VALUE;
+#else
+    if (bytes != NULL) { munmap((void*)bytes, length); }
+    if (fd >= 0) { ::close(fd); }
+    fd = -1;
+#endif
+    bytes = NULL;
+    length = 0;
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+unsigned long long fnv1aHash(const unsigned char* data, size_t size){
+    unsigned long long hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
@@ -0,0 +1,45 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  --- MappedFile.h ---
+//
+//  Read only memory mapping of a whole file (mmap, MapViewOfFile on
+//  Windows). The bytes stay valid until close() or destruction.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef __MAPPEDFILE_H__
+#define __MAPPEDFILE_H__
+
+#include <stddef.h>
+
+class MappedFile{
+public:
+
+    MappedFile();
+    ~MappedFile(){ close(); }
+
+    // false if the file can't be opened or mapped, an empty file maps to size 0
+    bool open(const char* path);
+    void close();
+
+    const unsigned char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    MappedFile(const MappedFile&);            // not copyable
+    MappedFile& operator=(const MappedFile&);
+
+    const unsigned char* bytes;
+    size_t length;
+#if defined(_WIN32)
+    void* file;
+    void* mapping;
+#else
+    int fd;
+#endif
+};
+
+// 64 bits FNV-1a hash of the bytes
+unsigned long long fnv1aHash(const unsigned char* data, size_t size);
+
+#endif // __MAPPEDFILE_H__
@@ -6,8 +6,258 @@
 //////////////////////////////////////////////////////////////////////////////
 
 #include "common.h"
+#include "MappedFile.h"
+
+namespace {
+
+// Bump when the layout of the cache changes
+const unsigned int meshCacheVersion = 3;
+const char meshCacheMagic[8] = { 'R', 'T', 'M', 'E', 'S', 'H', 0, 0 };
+
+// Followed by nvertices vec3, nuvs vec2, nnormals vec3 and nindices
+// unsigned int, native byte order
+struct MeshCacheHeader{
+    char magic[8];
+    unsigned int version;
+    unsigned int hasUV;
+    unsigned int hasNormals;
+    unsigned int padding;
+    unsigned long long sourceHash;
+    unsigned long long nvertices;
+    unsigned long long nuvs;
+    unsigned long long nnormals;
+    unsigned long long nindices;
+    float box_min[3];
+    float box_max[3];
+    float center[3];
+    float scale;
+};
 
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
 bool Mesh::loadOBJ(const char * path){
+    MappedFile source;
+    if (!source.open(path)) {
+        printf("Impossible to open the file !\n");
+        return false;
+    }
+
+    // the cache is valid as long as the OBJ bytes are the same
+    unsigned long long sourceHash = fnv1aHash(source.data(), source.size());
+    std::string cachePath = std::string(path) + ".cache";
+    if (loadCache(cachePath.c_str(), sourceHash)) {
+        return true;
+    }
+
+    if (!parseOBJ(source.data(), source.size())) {
+        return false;
+    }
+
+    // a read only folder only means no cache
+    writeCache(cachePath.c_str(), sourceHash);
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+void Mesh::fitModelView(){
+    center = box_min+(box_max-box_min)/2.0;
+    scale = (std::max)(box_max.x - box_min.x, box_max.y-box_min.y);
+
+    model_view = Scale(1.0/scale,           //Make the extents 0-1
+                       1.0/scale,
+                       1.0/scale)*
+            Translate(-center);  //Orient Model About Center
+}
+
+/* -------------------------------------------------------------------------- */
+/* ------ Corners sharing position, uv and normal share one vertex.    ----- */
+/* ------ The vertices using a position are chained from the first one ----- */
+/* ------ so the result doesn't depend on any hash order.              ----- */
+void Mesh::setTriangles(const std::vector < vec3 >& objVertices, const std::vector < vec2 >& objUVs,
+                        const std::vector < vec3 >& objNormals, const std::vector < int >& corners,
+                        bool withUV, bool withNormals){
+    hasUV = withUV;
+    hasNormals = withNormals;
+
+    const size_t ncorners = corners.size() / 3;
+    std::vector < int > firstVertex(objVertices.size(), -1);
+    std::vector < int > nextVertex;       // next vertex with the same position
+    std::vector < int > vertexUV, vertexNormal;
+
+    vertices.clear();
+    uvs.clear();
+    normals.clear();
+    indices.resize(ncorners);
+
+    for (size_t k = 0; k < ncorners; k++) {
+        const int* corner = &corners[3 * k];
+        const int vt = withUV ? corner[1] : -1;
+        const int vn = withNormals ? corner[2] : -1;
+
+        int vertex = firstVertex[corner[0]], last = -1;
+        while (vertex >= 0 && (vertexUV[vertex] != vt || vertexNormal[vertex] != vn)) {
+            last = vertex;
+            vertex = nextVertex[vertex];
+        }
+        if (vertex < 0) {
+            vertex = (int)vertices.size();
+            if (last < 0) { firstVertex[corner[0]] = vertex; }
+            else          { nextVertex[last] = vertex; }
+            nextVertex.push_back(-1);
+            vertexUV.push_back(vt);
+            vertexNormal.push_back(vn);
+
+            vertices.push_back(objVertices[corner[0]]);
+            if (withUV)      { uvs.push_back(objUVs[vt]); }
+            if (withNormals) { normals.push_back(objNormals[vn]); }
+        }
+        indices[k] = vertex;
+    }
+
+    if (!withNormals) {
+        // smooth normals for the display, sum of the (area weighted)
+        // normals of the triangles around the vertex
+        normals.assign(vertices.size(), vec3(0.0, 0.0, 0.0));
+        for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+            const vec3& a = vertices[indices[t]];
+            vec3 N = cross(vertices[indices[t+1]] - a, vertices[indices[t+2]] - a);
+            for (int j = 0; j < 3; j++) { normals[indices[t+j]] += N; }
+        }
+        for (size_t i = 0; i < normals.size(); i++) {
+            float len = length(normals[i]);
+            normals[i] = (len > 0.0f) ? normals[i] / len : vec3(0.0, 0.0, 1.0);
+        }
+    }
+
+    // extents of every declared vertex
+    box_min = vec3((std::numeric_limits< float >::max)());
+    box_max = -box_min;
+    for (size_t i = 0; i < objVertices.size(); i++) {
+        const vec3& v = objVertices[i];
+        box_min = vec3((std::min)(box_min.x, v.x), (std::min)(box_min.y, v.y), (std::min)(box_min.z, v.z));
+        box_max = vec3((std::max)(box_max.x, v.x), (std::max)(box_max.y, v.y), (std::max)(box_max.z, v.z));
+    }
+    if (objVertices.empty()) { box_min = box_max = vec3(0.0, 0.0, 0.0); }
+    fitModelView();
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+bool Mesh::loadCache(const char * cachePath, unsigned long long sourceHash){
+    MappedFile cache;
+    if (!cache.open(cachePath) || cache.size() < sizeof(MeshCacheHeader)) {
+        return false;
+    }
+
+    MeshCacheHeader header;
+    memcpy(&header, cache.data(), sizeof(header));
+    if (memcmp(header.magic, meshCacheMagic, sizeof(meshCacheMagic)) != 0 ||
+        header.version != meshCacheVersion || header.sourceHash != sourceHash) {
+        return false;
+    }
+
+    // counts of a corrupted header could overflow the sizes below
+    if (header.nvertices > cache.size() || header.nuvs > cache.size() ||
+        header.nnormals > cache.size() || header.nindices > cache.size()) {
+        return false;
+    }
+    size_t verticesBytes = header.nvertices * sizeof(vec3);
+    size_t uvsBytes      = header.nuvs      * sizeof(vec2);
+    size_t normalsBytes  = header.nnormals  * sizeof(vec3);
+    size_t indicesBytes  = header.nindices  * sizeof(unsigned int);
+    if (cache.size() != sizeof(header) + verticesBytes + uvsBytes + normalsBytes + indicesBytes) {
+        return false;
+    }
+
+    // uvs and normals go with the vertices, whole triangles only
+    const unsigned long long nvertices = header.nvertices;
+    if ((header.nuvs != 0 && header.nuvs != nvertices) || (header.hasUV && header.nuvs != nvertices) ||
+        (header.nnormals != 0 && header.nnormals != nvertices) ||
+        (header.hasNormals && header.nnormals != nvertices) || header.nindices % 3 != 0) {
+        return false;
+    }
+
+    // no parsing : the arrays are copied as they are
+    const unsigned char* data = cache.data() + sizeof(header);
+    const vec3* cachedVertices = reinterpret_cast< const vec3* >(data);
+    const vec2* cachedUVs      = reinterpret_cast< const vec2* >(data + verticesBytes);
+    const vec3* cachedNormals  = reinterpret_cast< const vec3* >(data + verticesBytes + uvsBytes);
+    const unsigned int* cachedIndices = reinterpret_cast< const unsigned int* >(data + verticesBytes + uvsBytes + normalsBytes);
+
+    // an index past the vertices would be read by the renderer
+    for (size_t i = 0; i < header.nindices; i++) {
+        if (cachedIndices[i] >= nvertices) { return false; }
+    }
+
+    vertices.assign(cachedVertices, cachedVertices + header.nvertices);
+    uvs.assign(cachedUVs, cachedUVs + header.nuvs);
+    normals.assign(cachedNormals, cachedNormals + header.nnormals);
+    indices.assign(cachedIndices, cachedIndices + header.nindices);
+
+    hasUV      = header.hasUV != 0;
+    hasNormals = header.hasNormals != 0;
+    box_min = vec3(header.box_min[0], header.box_min[1], header.box_min[2]);
+    box_max = vec3(header.box_max[0], header.box_max[1], header.box_max[2]);
+    center  = vec3(header.center[0], header.center[1], header.center[2]);
+    fitModelView();
+
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+bool Mesh::writeCache(const char * cachePath, unsigned long long sourceHash) const{
+    MeshCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, meshCacheMagic, sizeof(meshCacheMagic));
+    header.version    = meshCacheVersion;
+    header.hasUV      = hasUV ? 1 : 0;
+    header.hasNormals = hasNormals ? 1 : 0;
+    header.sourceHash = sourceHash;
+    header.nvertices  = vertices.size();
+    header.nuvs       = uvs.size();
+    header.nnormals   = normals.size();
+    header.nindices   = indices.size();
+    for (int k = 0; k < 3; k++) {
+        header.box_min[k] = box_min[k];
+        header.box_max[k] = box_max[k];
+        header.center[k]  = center[k];
+    }
+    header.scale = scale;
+
+    // written beside then renamed : a reader never maps a half written cache
+    const std::string temporary = std::string(cachePath) + ".tmp";
+    FILE * file = fopen(temporary.c_str(), "wb");
+    if (file == NULL) {
+        return false;
+    }
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+    if (written && !vertices.empty()) { written = fwrite(&vertices[0], sizeof(vec3), vertices.size(), file) == vertices.size(); }
+    if (written && !uvs.empty())      { written = fwrite(&uvs[0],      sizeof(vec2), uvs.size(),      file) == uvs.size(); }
+    if (written && !normals.empty())  { written = fwrite(&normals[0],  sizeof(vec3), normals.size(),  file) == normals.size(); }
+    if (written && !indices.empty())  { written = fwrite(&indices[0],  sizeof(unsigned int), indices.size(), file) == indices.size(); }
+    written = (fclose(file) == 0) && written;
+
+#if defined(_WIN32)
+    // rename doesn't replace an existing file on Windows
+    if (written) { remove(cachePath); }
+#endif
+    written = written && rename(temporary.c_str(), cachePath) == 0;
+
+    // never leave a truncated cache behind
+    if (!written) {
+        remove(temporary.c_str());
+    }
+    return written;
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+bool Mesh::parseOBJSimple(const char * path){
     std::vector< unsigned int > vertexIndices, uvIndices, normalIndices;
     std::vector< vec3 > temp_vertices;
     std::vector< vec2 > temp_uvs;
@@ -35,12 +285,6 @@ bool Mesh::loadOBJ(const char * path){
             vec3 vertex;
             sscanf(&line[2], "%f %f %f", &vertex.x, &vertex.y, &vertex.z );
             temp_vertices.push_back(vertex);
-            if(vertex.x < box_min.x){box_min.x = vertex.x; }
-            if(vertex.y < box_min.y){box_min.y = vertex.y; }
-            if(vertex.z < box_min.z){box_min.z = vertex.z; }
-            if(vertex.x > box_max.x){box_max.x = vertex.x; }
-            if(vertex.y > box_max.y){box_max.y = vertex.y; }
-            if(vertex.z > box_max.z){box_max.z = vertex.z; }
         }else if ( strcmp( lineHeader, "vt" ) == 0 ){
             vec2 uv;
             sscanf(&line[3], "%f %f", &uv.x, &uv.y );
@@ -107,87 +351,80 @@ bool Mesh::loadOBJ(const char * path){
     //    std::cout << "Read " << vertexIndices.size()/3 << " faces\n";
     //
 
-    // For each vertex of each triangle
+    // (v, vt, vn) of each corner, 0 based
+    std::vector< int > corners(3 * vertexIndices.size());
     for( unsigned int i=0; i<vertexIndices.size(); i++ ){
-        unsigned int vertexIndex = vertexIndices[i];
-        vec4 vertex = vec4(temp_vertices[ vertexIndex-1 ], 1.0);
-        vertices.push_back(vertex);
-    }
-
-    if(hasUV){
-        for( unsigned int i=0; i<uvIndices.size(); i++ ){
-            unsigned int uvIndex = uvIndices[i];
-            vec2 uv = temp_uvs[ uvIndex-1 ];
-            uvs.push_back(uv);
-        }
-    }
-
-    for( unsigned int i=0; i<normalIndices.size(); i++ ){
-        unsigned int normalIndex = normalIndices[i];
-        vec3 normal = temp_normals[ normalIndex-1 ];
-        normals.push_back(normal);
+        corners[3*i]   = vertexIndices[i] - 1;
+        corners[3*i+1] = hasUV ? (int)uvIndices[i] - 1 : -1;
+        corners[3*i+2] = normalIndices[i] - 1;
     }
 
-    //    std::cout << "Total " << vertices.size() << " vertices\n";
-    //    std::cout << "Total " << normals.size() << " normals\n";
-
-
-    center = box_min+(box_max-box_min)/2.0;
-    scale = (std::max)(box_max.x - box_min.x, box_max.y-box_min.y);
-
-    model_view = Scale(1.0/scale,           //Make the extents 0-1
-                       1.0/scale,
-                       1.0/scale)*
-            Translate(-center);  //Orient Model About Center
-
+    setTriangles(temp_vertices, temp_uvs, temp_normals, corners, hasUV, true);
 
     return true;
 }
 
+/* -------------------------------------------------------------------------- */
+/* ------ Start on the corners of a cube, each step splits every       ----- */
+/* ------ triangle in two through the middle of its first edge. Flat   ----- */
+/* ------ arrays : the midpoints are found by sorting the split edges, ----- */
+/* ------ the neighbours splitting the same edge share its midpoint.   ----- */
 bool Mesh::makeSubdivisionSphere(int steps, vec3 center, double radius){
 
     box_min = center + radius*vec3(-1,-1,-1);
     box_max = center + radius*vec3(1,1,1);
 
+    const float c = 0.57735;
+    const vec3 cube[8] = { vec3(c, c, c),   vec3(-c, c, -c),  vec3(c, c, -c),   vec3(-c, c, c),
+                           vec3(c, -c, c),  vec3(-c, -c, -c), vec3(c, -c, -c),  vec3(-c, -c, c) };
+    const unsigned int faces[36] = { 0, 1, 2,  1, 0, 3,  4, 5, 6,  5, 4, 7,  0, 6, 2,  6, 0, 4,
+                                     3, 5, 1,  5, 3, 7,  0, 7, 4,  7, 0, 3,  2, 5, 6,  5, 2, 1 };
+
+    std::vector< vec3 > points(cube, cube + 8);
+    std::vector< unsigned int > tris(faces, faces + 36), newTris;
+    std::vector< unsigned long long > edges;
+    const float l = length(points[0]);
+
+    for(int s=0; s < steps; s++){
+        const size_t ntris = tris.size() / 3;
+
+        // first edge of every triangle, once
+        edges.resize(ntris);
+        for(size_t t = 0; t < ntris; t++){
+            unsigned long long a = tris[3*t], b = tris[3*t+1];
+            edges[t] = (a < b) ? (a << 32 | b) : (b << 32 | a);
+        }
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+        const size_t firstMid = points.size();
+        points.resize(firstMid + edges.size());
+        for(size_t e = 0; e < edges.size(); e++){
+            const vec3& a = points[edges[e] >> 32];
+            const vec3& b = points[edges[e] & 0xffffffffu];
+            points[firstMid + e] = setLength((a + b) * 0.5f, l); // put in on the sphere
+        }
 
-    std::list < SphereTriangle > tris;
-
-    tris.push_back(SphereTriangle(vec3(0.57735, 0.57735, 0.57735),    vec3(-0.57735, 0.57735, -0.57735), vec3(0.57735, 0.57735, -0.57735)));
-    tris.push_back(SphereTriangle(vec3(-0.57735, 0.57735, -0.57735),  vec3(0.57735, 0.57735, 0.57735), vec3(-0.57735, 0.57735, 0.57735)));
-    tris.push_back(SphereTriangle(vec3(0.57735, -0.57735, 0.57735),   vec3(-0.57735, -0.57735, -0.57735), vec3(0.57735, -0.57735, -0.57735)));
-    tris.push_back(SphereTriangle(vec3(-0.57735, -0.57735, -0.57735), vec3(0.57735, -0.57735, 0.57735), vec3(-0.57735, -0.57735, 0.57735)));
-    tris.push_back(SphereTriangle(vec3(0.57735, 0.57735, 0.57735),    vec3(0.57735, -0.57735, -0.57735), vec3(0.57735, 0.57735, -0.57735)));
-    tris.push_back(SphereTriangle(vec3(0.57735, -0.57735, -0.57735),  vec3(0.57735, 0.57735, 0.57735), vec3(0.57735, -0.57735, 0.57735)));
-    tris.push_back(SphereTriangle(vec3(-0.57735, 0.57735, 0.57735),   vec3(-0.57735, -0.57735, -0.57735), vec3(-0.57735, 0.57735, -0.57735)));
-    tris.push_back(SphereTriangle(vec3(-0.57735, -0.57735, -0.57735), vec3(-0.57735, 0.57735, 0.57735), vec3(-0.57735, -0.57735, 0.57735)));
-    tris.push_back(SphereTriangle(vec3(0.57735, 0.57735, 0.57735),    vec3(-0.57735, -0.57735, 0.57735), vec3(0.57735, -0.57735, 0.57735)));
-    tris.push_back(SphereTriangle(vec3(-0.57735, -0.57735, 0.57735),  vec3(0.57735, 0.57735, 0.57735), vec3(-0.57735, 0.57735, 0.57735)));
-    tris.push_back(SphereTriangle(vec3(0.57735, 0.57735, -0.57735),   vec3(-0.57735, -0.57735, -0.57735), vec3(0.57735, -0.57735, -0.57735)));
-    tris.push_back(SphereTriangle(vec3(-0.57735, -0.57735, -0.57735), vec3(0.57735, 0.57735, -0.57735), vec3(-0.57735, 0.57735, -0.57735)));
-
-    for(unsigned int s=0; s < steps; s++){
-        std::list< SphereTriangle > newTris;
-        float l = length(tris.begin()->a);
-        for(std::list<SphereTriangle>::iterator i = tris.begin(); i != tris.end(); ++i) { // go through all triangles
-            vec3 mid = (i->a + i->b) * 0.5f; // point betwenn points A and B
-            mid = setLength(mid, l); // put in on the sphere
-            newTris.push_back(SphereTriangle(i->b, i->c, mid)); // remember new triangles
-            newTris.push_back(SphereTriangle(i->a, i->c, mid));
+        newTris.resize(2 * tris.size());
+        for(size_t t = 0; t < ntris; t++){
+            unsigned long long a = tris[3*t], b = tris[3*t+1];
+            unsigned long long key = (a < b) ? (a << 32 | b) : (b << 32 | a);
+            unsigned int mid = (unsigned int)(firstMid + (std::lower_bound(edges.begin(), edges.end(), key) - edges.begin()));
+            unsigned int* out = &newTris[6*t];
+            out[0] = tris[3*t+1]; out[1] = tris[3*t+2]; out[2] = mid; // remember new triangles
+            out[3] = tris[3*t];   out[4] = tris[3*t+2]; out[5] = mid;
         }
         tris.swap(newTris); // use new set of triangles;
     }
 
-
-
-    for(std::list<SphereTriangle>::iterator i = tris.begin(); i != tris.end(); ++i) {
-        vertices.push_back(vec4(normalize(i->a)*radius+center, 1.0));
-        vertices.push_back(vec4(normalize(i->b)*radius+center, 1.0));
-        vertices.push_back(vec4(normalize(i->c)*radius+center, 1.0));
-
-        normals.push_back(normalize(i->a));
-        normals.push_back(normalize(i->b));
-        normals.push_back(normalize(i->c));
+    hasNormals = true;
+    vertices.resize(points.size());
+    normals.resize(points.size());
+    for(size_t i = 0; i < points.size(); i++){
+        normals[i] = normalize(points[i]);
+        vertices[i] = normals[i]*radius+center;
     }
+    indices.swap(tris);
 
     return true;
 }
@@ -11,9 +11,14 @@ using namespace Angel;
 class Mesh{
 public:
   bool hasUV;
-  std::vector < vec4 > vertices;
+  bool hasNormals;  // normals come from the file, computed (smooth) otherwise
+
+  // Indexed triangles : shared vertices, one normal (and uv) per vertex,
+  // 3 indices per triangle
+  std::vector < vec3 > vertices;
   std::vector < vec2 > uvs;
   std::vector < vec3 > normals;
+  std::vector < unsigned int > indices;
 
   vec3 box_min;
   vec3 box_max;
@@ -22,7 +27,9 @@ public:
 
   mat4 model_view;
 
-  Mesh(): box_min((std::numeric_limits< float >::max)(),
+  Mesh(): hasUV(false),
+          hasNormals(false),
+          box_min((std::numeric_limits< float >::max)(),
                   (std::numeric_limits< float >::max)(),
                   (std::numeric_limits< float >::max)() ),
           box_max(0,0,0),
@@ -31,7 +38,9 @@ public:
           model_view(){ }
 
   Mesh(const char * path)
-    : box_min((std::numeric_limits< float >::max)(),
+    : hasUV(false),
+    hasNormals(false),
+    box_min((std::numeric_limits< float >::max)(),
               (std::numeric_limits< float >::max)(),
               (std::numeric_limits< float >::max)() ),
     box_max(0,0,0),
@@ -39,18 +48,24 @@ public:
     scale(1.0),
     model_view(){ loadOBJ(path); }
 
-  unsigned int getNumTri(){ return vertices.size()/3; }
+  unsigned int getNumTri() const { return indices.size()/3; }
 
+  // Loads path.cache instead of parsing when it was written from the same
+  // OBJ content, writes it otherwise
   bool loadOBJ(const char * path);
 
-  class SphereTriangle{
-  public:
-    SphereTriangle(vec3 _p1, vec3 _p2, vec3 _p3): a(_p1), b(_p2), c(_p3){};
-    vec3 a;
-    vec3 b;
-    vec3 c;
-  };
+  // Binary cache : header and raw vertex/uv/normal/index arrays, tagged with the
+  // FNV-1a hash of the OBJ it comes from
+  bool loadCache(const char * cachePath, unsigned long long sourceHash);
+  bool writeCache(const char * cachePath, unsigned long long sourceHash) const;
+
+  // Parallel parser of the OBJ text (ObjParser.cpp) : any line length,
+  // polygons split in triangle fans, smooth normals when the file has none
+  bool parseOBJ(const unsigned char* data, size_t size);
 
+  // Original single threaded parser, triangles with normals only. Kept as
+  // the reference of the OBJ loading benchmark
+  bool parseOBJSimple(const char * path);
 
   vec3 setLength(vec3 p1, float r){
     float rl = r/length(p1);
@@ -61,6 +76,17 @@ public:
 
   bool makeParametricSphere(int steps=32){ return true; }
 
+private:
+  // model_view from box_min and box_max
+  void fitModelView();
+
+  // Indexed arrays from triangle corners given as (v, vt, vn) triples in
+  // the OBJ arrays : one vertex per distinct triple, in order of first use
+  void setTriangles(const std::vector < vec3 >& objVertices, const std::vector < vec2 >& objUVs,
+                    const std::vector < vec3 >& objNormals, const std::vector < int >& corners,
+                    bool withUV, bool withNormals);
+
+public:
   friend std::ostream& operator << ( std::ostream& os, const Mesh& v ) {
     os << "Vertices:\n";
     for(unsigned int i=0; i < v.vertices.size(); i++){
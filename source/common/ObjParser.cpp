@@ -0,0 +1,330 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  --- ObjParser.cpp ---
+//
+//  Parallel OBJ parser : the mapped file is cut into line aligned chunks
+//  parsed by the OpenMP threads, then the chunks are merged in file order
+//  so that the mesh doesn't depend on the number of threads.
+//  Faces with more than 3 corners are split in fans, corners with the same
+//  position, uv and normal share one vertex of the indexed mesh.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "common.h"
+#include <climits>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+
+// Chunks of about 1MB, but at least a few per thread for load balancing
+const size_t minChunkSize     = 1 << 20;
+const int    chunksPerThread  = 4;
+
+const int    noIndex          = INT_MIN;
+
+// Corners of the faces of a chunk, indices are 0 based. Negative (relative)
+// OBJ indices refer to the elements before the line : they are first made
+// relative to the start of the chunk and fixed once the chunks are merged.
+enum { relativeV = 1, relativeVT = 2, relativeVN = 4 };
+
+struct ObjChunk{
+    const char* begin;
+    const char* end;
+
+    std::vector < vec3 > positions;
+    std::vector < vec2 > uvs;
+    std::vector < vec3 > normals;
+
+    std::vector < int > corners;              // v, vt, vn per corner
+    std::vector < unsigned char > relative;   // relativeV | relativeVT | relativeVN per corner
+    std::vector < int > faceSizes;
+
+    unsigned int lines;
+    unsigned int errorLine;                   // 1 based line in the chunk, 0 : no error
+};
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+inline bool isBlank(char c){ return c == ' ' || c == '\t' || c == '\r'; }
+inline bool isDigit(char c){ return c >= '0' && c <= '9'; }
+
+inline const char* skipBlanks(const char* p, const char* e){
+    while (p < e && isBlank(*p)) { p++; }
+    return p;
+}
+
+/* -------------------------------------------------------------------------- */
+/* ------ [+-]digits[.digits][(e|E)[+-]digits], NULL when no number    ----- */
+/* ------ 19 significant digits are kept, enough for a float            ----- */
+const char* parseFloat(const char* p, const char* e, float& value){
+    static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+                                     1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19,
+                                     1e20, 1e21, 1e22 };
+    p = skipBlanks(p, e);
+
+    bool negative = false;
+    if (p < e && (*p == '-' || *p == '+')) { negative = (*p == '-'); p++; }
+
+    unsigned long long mantissa = 0;
+    int digits = 0, exponent = 0;
+    bool any = false;
+    for (; p < e && isDigit(*p); p++) {
+        any = true;
+        if (digits < 19) { mantissa = mantissa * 10 + (*p - '0'); if (mantissa) { digits++; } }
+        else { exponent++; }
+    }
+    if (p < e && *p == '.') {
+        for (p++; p < e && isDigit(*p); p++) {
+            any = true;
+            if (digits < 19) { mantissa = mantissa * 10 + (*p - '0'); if (mantissa) { digits++; } exponent--; }
+        }
+    }
+    if (!any) { return NULL; }
+
+    if (p < e && (*p == 'e' || *p == 'E')) {
+        const char* q = p + 1;
+        bool negativeExp = false;
+        if (q < e && (*q == '-' || *q == '+')) { negativeExp = (*q == '-'); q++; }
+        if (q < e && isDigit(*q)) {
+            int exp = 0;
+            for (; q < e && isDigit(*q); q++) { if (exp < 10000) { exp = exp * 10 + (*q - '0'); } }
+            exponent += negativeExp ? -exp : exp;
+            p = q;
+        }
+    }
+
+    // powers of ten up to 1e22 are exact doubles : one rounding
+    double v = (double)mantissa;
+    if (exponent < 0) {
+        v = (exponent >= -22) ? v / powers[-exponent] : v * std::pow(10.0, exponent);
+    }
+    else if (exponent > 0) {
+        v = (exponent <= 22) ? v * powers[exponent] : v * std::pow(10.0, exponent);
+    }
+
+    value = (float)(negative ? -v : v);
+    return p;
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+const char* parseInt(const char* p, const char* e, int& value){
+    bool negative = false;
+    if (p < e && (*p == '-' || *p == '+')) { negative = (*p == '-'); p++; }
+    if (!(p < e && isDigit(*p))) { return NULL; }
+    long long v = 0;
+    for (; p < e && isDigit(*p); p++) { if (v < INT_MAX) { v = v * 10 + (*p - '0'); } }
+    value = (int)(negative ? -(std::min)(v, (long long)INT_MAX) : (std::min)(v, (long long)INT_MAX));
+    return p;
+}
+
+/* -------------------------------------------------------------------------- */
+/* ------ One face index : 1 based, or negative relative to count       ----- */
+inline bool storeIndex(int index, int count, int& stored, unsigned char& relative, unsigned char flag){
+    if (index > 0) { stored = index - 1; return true; }
+    if (index < 0) { stored = count + index; relative |= flag; return true; }
+    return false;
+}
+
+/* -------------------------------------------------------------------------- */
+/* ------ v, v/vt, v//vn or v/vt/vn                                     ----- */
+const char* parseCorner(const char* p, const char* e, ObjChunk& chunk){
+    int v, vt = 0, vn = 0;
+    p = parseInt(p, e, v);
+    if (p == NULL) { return NULL; }
+    if (p < e && *p == '/') {
+        p++;
+        if (p < e && *p != '/') {
+            p = parseInt(p, e, vt);
+            if (p == NULL) { return NULL; }
+        }
+        if (p < e && *p == '/') {
+            p = parseInt(p + 1, e, vn);
+            if (p == NULL) { return NULL; }
+        }
+    }
+
+    int stored[3] = { noIndex, noIndex, noIndex };
+    unsigned char relative = 0;
+    if (!storeIndex(v, (int)chunk.positions.size(), stored[0], relative, relativeV)) { return NULL; }
+    if (vt != 0) { storeIndex(vt, (int)chunk.uvs.size(), stored[1], relative, relativeVT); }
+    if (vn != 0) { storeIndex(vn, (int)chunk.normals.size(), stored[2], relative, relativeVN); }
+
+    chunk.corners.insert(chunk.corners.end(), stored, stored + 3);
+    chunk.relative.push_back(relative);
+    return p;
+}
+
+/* -------------------------------------------------------------------------- */
+/* ------ Parse every line of the chunk, stop at the first bad one      ----- */
+void parseChunk(ObjChunk& chunk){
+    chunk.lines = 0;
+    chunk.errorLine = 0;
+
+    const char* p = chunk.begin;
+    while (p < chunk.end) {
+        const char* e = (const char*)memchr(p, '\n', chunk.end - p);
+        if (e == NULL) { e = chunk.end; }
+        chunk.lines++;
+
+        const char* q = skipBlanks(p, e);
+        bool ok = true;
+
+        if (q + 1 < e && q[0] == 'v' && isBlank(q[1])) {
+            vec3 position;
+            ok = (q = parseFloat(q + 1, e, position.x)) != NULL && (q = parseFloat(q, e, position.y)) != NULL
+                 && (q = parseFloat(q, e, position.z)) != NULL;
+            chunk.positions.push_back(position);
+        }
+        else if (q + 2 < e && q[0] == 'v' && q[1] == 't' && isBlank(q[2])) {
+            // the v coordinate is optional
+            vec2 uv(0.0, 0.0);
+            ok = (q = parseFloat(q + 2, e, uv.x)) != NULL;
+            if (ok) { parseFloat(q, e, uv.y); }
+            chunk.uvs.push_back(uv);
+        }
+        else if (q + 2 < e && q[0] == 'v' && q[1] == 'n' && isBlank(q[2])) {
+            vec3 normal;
+            ok = (q = parseFloat(q + 2, e, normal.x)) != NULL && (q = parseFloat(q, e, normal.y)) != NULL
+                 && (q = parseFloat(q, e, normal.z)) != NULL;
+            chunk.normals.push_back(normal);
+        }
+        else if (q + 1 < e && q[0] == 'f' && isBlank(q[1])) {
+            int size = 0;
+            q = skipBlanks(q + 1, e);
+            while (ok && q < e && *q != '#') {
+                q = parseCorner(q, e, chunk);
+                ok = (q != NULL);
+                if (ok) { size++; q = skipBlanks(q, e); }
+            }
+            ok = ok && size >= 3;
+            if (ok) { chunk.faceSizes.push_back(size); }
+        }
+        // comments, groups, materials ... are skipped
+
+        if (!ok) {
+            chunk.errorLine = chunk.lines;
+            return;
+        }
+        p = e + 1;
+    }
+}
+
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+bool Mesh::parseOBJ(const unsigned char* data, size_t size){
+    vertices.clear();
+    uvs.clear();
+    normals.clear();
+    indices.clear();
+
+    const char* text = (const char*)data;
+    const char* textEnd = text + size;
+
+    // Line aligned chunks : each boundary moves to the start of the next line
+    int nthreads = 1;
+#ifdef _OPENMP
+    nthreads = omp_get_max_threads();
+#endif
+    size_t nchunks = (std::max)((size_t)1, (std::min)(size / minChunkSize + 1, (size_t)(nthreads * chunksPerThread)));
+    std::vector < ObjChunk > chunks(nchunks);
+    const char* begin = text;
+    for (size_t c = 0; c < nchunks; c++) {
+        const char* end = (c + 1 == nchunks) ? textEnd : text + size * (c + 1) / nchunks;
+        if (end < begin) { end = begin; }
+        const char* newline = (const char*)memchr(end, '\n', textEnd - end);
+        end = (newline == NULL || c + 1 == nchunks) ? textEnd : newline + 1;
+        chunks[c].begin = begin;
+        chunks[c].end = end;
+        begin = end;
+    }
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int c = 0; c < (int)nchunks; c++) {
+        parseChunk(chunks[c]);
+    }
+
+    // Chunk offsets, in file order
+    std::vector < int > positionOffset(nchunks + 1, 0), uvOffset(nchunks + 1, 0), normalOffset(nchunks + 1, 0);
+    std::vector < size_t > triangleOffset(nchunks + 1, 0);
+    unsigned int lineOffset = 0;
+    for (size_t c = 0; c < nchunks; c++) {
+        if (chunks[c].errorLine != 0) {
+            printf("OBJ parse error line %u\n", lineOffset + chunks[c].errorLine);
+            return false;
+        }
+        lineOffset += chunks[c].lines;
+        positionOffset[c + 1] = positionOffset[c] + (int)chunks[c].positions.size();
+        uvOffset[c + 1]       = uvOffset[c]       + (int)chunks[c].uvs.size();
+        normalOffset[c + 1]   = normalOffset[c]   + (int)chunks[c].normals.size();
+        size_t ntri = 0;
+        for (unsigned int f = 0; f < chunks[c].faceSizes.size(); f++) { ntri += chunks[c].faceSizes[f] - 2; }
+        triangleOffset[c + 1] = triangleOffset[c] + ntri;
+    }
+
+    // Absolute indices, uvs and normals only if every corner has one
+    const int npositions = positionOffset[nchunks], nuvs = uvOffset[nchunks], nnormals = normalOffset[nchunks];
+    int badIndex = 0, withUV = 1, withNormal = 1;
+    #pragma omp parallel for schedule(dynamic, 1) reduction(|:badIndex) reduction(&:withUV, withNormal)
+    for (int c = 0; c < (int)nchunks; c++) {
+        ObjChunk& chunk = chunks[c];
+        for (size_t k = 0; k < chunk.relative.size(); k++) {
+            int* corner = &chunk.corners[3 * k];
+            if (chunk.relative[k] & relativeV)  { corner[0] += positionOffset[c]; }
+            if (chunk.relative[k] & relativeVT) { corner[1] += uvOffset[c]; }
+            if (chunk.relative[k] & relativeVN) { corner[2] += normalOffset[c]; }
+
+            if (corner[0] < 0 || corner[0] >= npositions) { badIndex = 1; }
+            if (corner[1] == noIndex) { withUV = 0; }
+            else if (corner[1] < 0 || corner[1] >= nuvs) { badIndex = 1; }
+            if (corner[2] == noIndex) { withNormal = 0; }
+            else if (corner[2] < 0 || corner[2] >= nnormals) { badIndex = 1; }
+        }
+    }
+    if (badIndex) {
+        printf("OBJ face index out of range\n");
+        return false;
+    }
+
+    // Global arrays : chunk c is copied at its offset
+    std::vector < vec3 > positions(npositions);
+    std::vector < vec2 > texCoords(nuvs);
+    std::vector < vec3 > vertexNormals(nnormals);
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int c = 0; c < (int)nchunks; c++) {
+        std::copy(chunks[c].positions.begin(), chunks[c].positions.end(), positions.begin() + positionOffset[c]);
+        std::copy(chunks[c].uvs.begin(),       chunks[c].uvs.end(),       texCoords.begin() + uvOffset[c]);
+        std::copy(chunks[c].normals.begin(),   chunks[c].normals.end(),   vertexNormals.begin() + normalOffset[c]);
+    }
+
+    // Corners of the fans of triangles, each chunk writes its own range
+    const size_t ntriangles = triangleOffset[nchunks];
+    std::vector < int > triangleCorners(9 * ntriangles);
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int c = 0; c < (int)nchunks; c++) {
+        const ObjChunk& chunk = chunks[c];
+        int* out = triangleCorners.empty() ? NULL : &triangleCorners[9 * triangleOffset[c]];
+        size_t first = 0;
+        for (unsigned int f = 0; f < chunk.faceSizes.size(); f++) {
+            const int n = chunk.faceSizes[f];
+            for (int k = 1; k + 1 < n; k++) {
+                const size_t fan[3] = { first, first + k, first + k + 1 };
+                for (int j = 0; j < 3; j++) {
+                    std::copy(&chunk.corners[3 * fan[j]], &chunk.corners[3 * fan[j]] + 3, out);
+                    out += 3;
+                }
+            }
+            first += n;
+        }
+    }
+
+    setTriangles(positions, texCoords, vertexNormals, triangleCorners, withUV != 0, withNormal != 0);
+
+    return true;
+}
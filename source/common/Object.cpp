@@ -10,7 +10,7 @@
 
 /* -------------------------------------------------------------------------- */
 /* -------------------------------------------------------------------------- */
-Object::IntersectionValues Sphere::intersect(vec4 p0, vec4 V){
+Object::IntersectionValues Sphere::intersect(const vec4& p0, const vec4& V, double /*tmin*/){
   IntersectionValues result;
 
   /*typedef struct {
@@ -18,12 +18,10 @@ Object::IntersectionValues Sphere::intersect(vec4 p0, vec4 V){
       vec4 P; // point of intersection 
       vec4 N; // normal at P 
       int ID_; // Id of object 
-      std::string name; // name of object 
   } IntersectionValues;
   */
   result.ID_ = -1; 
   result.t = this->raySphereIntersection(p0, V); 
-  result.name = this->name; 
   result.N = vec4(1.0, 0.0, 0.0, 1.0);
 
   if (result.t < (std::numeric_limits < double > ::max)())
@@ -38,12 +36,33 @@ Object::IntersectionValues Sphere::intersect(vec4 p0, vec4 V){
   return result;
 }
 
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+void Sphere::getBounds(vec3& bmin, vec3& bmax) const{
+  vec3 r(this->radius, this->radius, this->radius);
+  bmin = this->center - r;
+  bmax = this->center + r;
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+const Mesh& Sphere::getPreviewMesh() const{
+  // built once, thread safe initialization
+  static const Mesh unitSphere = [](){
+      Mesh sphere;
+      sphere.makeSubdivisionSphere(8);
+      return sphere;
+  }();
+  return unitSphere;
+}
+
 /* -------------------------------------------------------------------------- */
 /* ------ Ray = p0 + t*V  sphere at origin center and radius radius    : Find t ------- */
-double Sphere::raySphereIntersection(vec4 p0, vec4 V){
+double Sphere::raySphereIntersection(const vec4& p0, const vec4& V){
+  // t d*d + 2t d*(origin rayon - center) + (norm(no-c) - rv
+  // in double : the float kernels of SphereSet only cull the spheres
   double t   = std::numeric_limits< double >::infinity();
   
-  // t d*d + 2t d*(origin rayon - center) + (norm(no-c) - rv
   double c = Angel::dot(p0 - this->center, p0 - this->center) - this->radius* this->radius; // square norm 
   double a = Angel::dot(V, V); 
   double b = 2.0 * Angel::dot(V, p0 - this->center); 
@@ -64,11 +83,11 @@ double Sphere::raySphereIntersection(vec4 p0, vec4 V){
 
       if (t1 > 0.0 && t2 > 0.0) 
       {
-          t = min(t1, t2);
+          t = (std::min)(t1, t2);
       }
       else
       {
-          t = max(t1, t2); 
+          t = (std::max)(t1, t2); 
       }
 
       
@@ -79,12 +98,11 @@ double Sphere::raySphereIntersection(vec4 p0, vec4 V){
 
 /* -------------------------------------------------------------------------- */
 /* -------------------------------------------------------------------------- */
-Object::IntersectionValues Square::intersect(vec4 p0, vec4 V){
+Object::IntersectionValues Square::intersect(const vec4& p0, const vec4& V, double /*tmin*/){
   IntersectionValues result;
 
   result.ID_ = -1;
   result.t = this->raySquareIntersection(p0, V);
-  result.name = this->name;
   result.N = vec4(this->normal, 0.0);
   // r(t) = o + t*d
   result.P = p0 + result.t * V;
@@ -100,7 +118,19 @@ Object::IntersectionValues Square::intersect(vec4 p0, vec4 V){
 
 /* -------------------------------------------------------------------------- */
 /* -------------------------------------------------------------------------- */
-double Square::raySquareIntersection(vec4 p0, vec4 V){
+void Square::getBounds(vec3& bmin, vec3& bmax) const{
+  bmin = mesh.vertices[0];
+  bmax = bmin;
+  for (unsigned int i = 1; i < mesh.vertices.size(); i++) {
+      const vec3& v = mesh.vertices[i];
+      bmin = vec3((std::min)(bmin.x, v.x), (std::min)(bmin.y, v.y), (std::min)(bmin.z, v.z));
+      bmax = vec3((std::max)(bmax.x, v.x), (std::max)(bmax.y, v.y), (std::max)(bmax.z, v.z));
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+double Square::raySquareIntersection(const vec4& p0, const vec4& V){
   double t   = std::numeric_limits< double >::infinity();
   vec4 N = vec4(this->normal, 0.0); 
 
@@ -136,8 +166,199 @@ bool Square::insideTriangle(const vec4& a, const vec4& b, const vec4& c, const v
 bool Square::insideSquare(const vec4& p) const
 {
     // Inside Square / not triangle
-    bool trigABC = insideTriangle(mesh.vertices[0], mesh.vertices[1], mesh.vertices[2], p); 
-    bool trigDEF = insideTriangle(mesh.vertices[3], mesh.vertices[4], mesh.vertices[5], p); 
+    const unsigned int* index = &mesh.indices[0];
+    bool trigABC = insideTriangle(vec4(mesh.vertices[index[0]], 1.0), vec4(mesh.vertices[index[1]], 1.0), vec4(mesh.vertices[index[2]], 1.0), p); 
+    bool trigDEF = insideTriangle(vec4(mesh.vertices[index[3]], 1.0), vec4(mesh.vertices[index[4]], 1.0), vec4(mesh.vertices[index[5]], 1.0), p); 
 
     return trigABC || trigDEF;
 }
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+TriangleMesh::TriangleMesh(std::string name, const Mesh& source, mat4 transform) : Object(name), smooth(source.hasNormals){
+  const unsigned int ntri = source.getNumTri();
+  mat4 normalMatrix = transpose(invert(transform));
+
+  // world space copy of the shared vertices, used by the GL preview too
+  mesh.hasNormals = source.hasNormals;
+  mesh.vertices.resize(source.vertices.size());
+  mesh.normals.resize(source.normals.size());
+  for (unsigned int i = 0; i < source.vertices.size(); i++) {
+      vec4 v = transform * vec4(source.vertices[i], 1.0);
+      mesh.vertices[i] = vec3(v.x, v.y, v.z);
+  }
+  for (unsigned int i = 0; i < source.normals.size(); i++) {
+      vec4 N = normalMatrix * vec4(source.normals[i], 0.0);
+      mesh.normals[i] = normalize(vec3(N.x, N.y, N.z));
+  }
+
+  // per triangle boxes for the BVH
+  std::vector < vec3 > primMin(ntri), primMax(ntri);
+  box_min = vec3((std::numeric_limits< float >::max)());
+  box_max = -box_min;
+  for (unsigned int tri = 0; tri < ntri; tri++) {
+      primMin[tri] = vec3((std::numeric_limits< float >::max)());
+      primMax[tri] = -primMin[tri];
+      for (unsigned int k = 0; k < 3; k++) {
+          const vec3& v = mesh.vertices[source.indices[3*tri+k]];
+          primMin[tri] = vec3((std::min)(primMin[tri].x, v.x), (std::min)(primMin[tri].y, v.y), (std::min)(primMin[tri].z, v.z));
+          primMax[tri] = vec3((std::max)(primMax[tri].x, v.x), (std::max)(primMax[tri].y, v.y), (std::max)(primMax[tri].z, v.z));
+      }
+      box_min = vec3((std::min)(box_min.x, primMin[tri].x), (std::min)(box_min.y, primMin[tri].y), (std::min)(box_min.z, primMin[tri].z));
+      box_max = vec3((std::max)(box_max.x, primMax[tri].x), (std::max)(box_max.y, primMax[tri].y), (std::max)(box_max.z, primMax[tri].z));
+  }
+  bvh.build(primMin, primMax);
+
+  // triangles indexed in leaf order : a leaf reads contiguous indices
+  mesh.indices.resize(3 * ntri);
+  for (unsigned int slot = 0; slot < ntri; slot++) {
+      unsigned int tri = bvh.primIndices[slot];
+      for (unsigned int k = 0; k < 3; k++) {
+          mesh.indices[3*slot+k] = source.indices[3*tri+k];
+      }
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+Object::IntersectionValues TriangleMesh::intersect(const vec4& p0, const vec4& V, double tmin){
+  IntersectionValues result;
+  result.ID_ = -1;
+  result.t = std::numeric_limits< double >::infinity();
+  result.N = vec4(1.0, 0.0, 0.0, 0.0);
+
+  RayShear ray = shearRay(p0, V);
+  int hitSlot = -1;
+  double hb0 = 0.0, hb1 = 0.0, hb2 = 0.0;
+
+  // closest triangle, tmax shrinks as hits are found
+  bvh.traverseLeaves(p0, V, result.t, [&](int first, int count){
+      for (int slot = first; slot < first + count; slot++) {
+          double t, b0, b1, b2;
+          if (rayTriangleIntersection(ray, slot, tmin, result.t, t, b0, b1, b2)) {
+              result.t = t;
+              hitSlot = slot;
+              hb0 = b0; hb1 = b1; hb2 = b2;
+          }
+      }
+      return false;
+  });
+
+  if (hitSlot >= 0) {
+      // r(t) = o + t*d
+      result.P = p0 + result.t * V;
+      const unsigned int* index = &mesh.indices[3*hitSlot];
+      vec3 N;
+      if (smooth) {
+          N = float(hb0) * mesh.normals[index[0]] + float(hb1) * mesh.normals[index[1]] + float(hb2) * mesh.normals[index[2]];
+      }
+      else {
+          const vec3& a = mesh.vertices[index[0]];
+          N = cross(mesh.vertices[index[1]] - a, mesh.vertices[index[2]] - a);
+      }
+      result.N = vec4(normalize(N), 0.0);
+  }
+
+  return result;
+}
+
+/* -------------------------------------------------------------------------- */
+/* ------ Shadow rays : the first triangle found ends the traversal    ------ */
+bool TriangleMesh::occluded(const vec4& p0, const vec4& V, double tmin, double tmax){
+  RayShear ray = shearRay(p0, V);
+  bool hit = false;
+
+  bvh.traverseLeaves(p0, V, tmax, [&](int first, int count){
+      for (int slot = first; slot < first + count; slot++) {
+          double t, b0, b1, b2;
+          if (rayTriangleIntersection(ray, slot, tmin, tmax, t, b0, b1, b2)) {
+              hit = true;
+              return true;
+          }
+      }
+      return false;
+  });
+
+  return hit;
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+void TriangleMesh::getBounds(vec3& bmin, vec3& bmax) const{
+  bmin = box_min;
+  bmax = box_max;
+}
+
+/* -------------------------------------------------------------------------- */
+/* ------ Per ray part of the watertight test : the ray is mapped to  ------- */
+/* ------ +z by a permutation and a shear, done once for all triangles ------ */
+TriangleMesh::RayShear TriangleMesh::shearRay(const vec4& p0, const vec4& V){
+  RayShear ray;
+  double d[3] = { V.x, V.y, V.z };
+
+  // dimension where the ray direction is maximal
+  ray.kz = 0;
+  if (std::fabs(d[1]) > std::fabs(d[ray.kz])) { ray.kz = 1; }
+  if (std::fabs(d[2]) > std::fabs(d[ray.kz])) { ray.kz = 2; }
+  ray.kx = (ray.kz + 1) % 3;
+  ray.ky = (ray.kx + 1) % 3;
+  // keep the winding of the triangles
+  if (d[ray.kz] < 0.0) { std::swap(ray.kx, ray.ky); }
+
+  ray.Sx = d[ray.kx] / d[ray.kz];
+  ray.Sy = d[ray.ky] / d[ray.kz];
+  ray.Sz = 1.0 / d[ray.kz];
+
+  ray.org[0] = p0.x;
+  ray.org[1] = p0.y;
+  ray.org[2] = p0.z;
+  return ray;
+}
+
+/* -------------------------------------------------------------------------- */
+/* ------ Hit with tmin < t < tmax, b0 b1 b2 barycentrics of the      ------- */
+/* ------ 3 vertices. Both faces are hit.                             ------- */
+bool TriangleMesh::rayTriangleIntersection(const RayShear& ray, unsigned int tri, double tmin, double tmax,
+                                           double& t, double& b0, double& b1, double& b2) const{
+  const unsigned int* index = &mesh.indices[3*tri];
+  const vec3& v0 = mesh.vertices[index[0]];
+  const vec3& v1 = mesh.vertices[index[1]];
+  const vec3& v2 = mesh.vertices[index[2]];
+
+  // vertices relative to the ray origin
+  double A[3], B[3], C[3];
+  for (int k = 0; k < 3; k++) {
+      A[k] = v0[k] - ray.org[k];
+      B[k] = v1[k] - ray.org[k];
+      C[k] = v2[k] - ray.org[k];
+  }
+
+  // shear and scale
+  const double Ax = A[ray.kx] - ray.Sx * A[ray.kz];
+  const double Ay = A[ray.ky] - ray.Sy * A[ray.kz];
+  const double Bx = B[ray.kx] - ray.Sx * B[ray.kz];
+  const double By = B[ray.ky] - ray.Sy * B[ray.kz];
+  const double Cx = C[ray.kx] - ray.Sx * C[ray.kz];
+  const double Cy = C[ray.ky] - ray.Sy * C[ray.kz];
+
+  // scaled barycentrics : edge functions in the ray plane
+  const double U = Cx * By - Cy * Bx;
+  const double W2 = Ax * Cy - Ay * Cx;
+  const double W3 = Bx * Ay - By * Ax;
+
+  if ((U < 0.0 || W2 < 0.0 || W3 < 0.0) && (U > 0.0 || W2 > 0.0 || W3 > 0.0)) { return false; }
+
+  const double det = U + W2 + W3;
+  if (det == 0.0) { return false; }
+
+  // scaled hit distance
+  const double T = U * ray.Sz * A[ray.kz] + W2 * ray.Sz * B[ray.kz] + W3 * ray.Sz * C[ray.kz];
+
+  t = T / det;
+  if (!(t > tmin && t < tmax)) { return false; }
+
+  b0 = U / det;
+  b1 = W2 / det;
+  b2 = W3 / det;
+  return true;
+}
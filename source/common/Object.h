@@ -18,6 +18,7 @@ public:
 
     friend class Sphere;
     friend class Square;
+    friend class TriangleMesh;
 
     typedef struct{
         vec4 color;
@@ -29,12 +30,13 @@ public:
         float Kr;
     } ShadingValues;
 
+    // Plain hit record, no heap allocation : identify the object through ID_
+    // (index in the scene) and look its name up only when debugging
     typedef struct{
         double t;
         vec4 P;
         vec4 N;
         int ID_;
-        std::string name;
     } IntersectionValues;
 
 
@@ -67,7 +69,24 @@ public:
 
     mat4 getModelView(){ return C; }
 
-    virtual IntersectionValues intersect(vec4 p0, vec4 V)=0;
+    // Geometry drawn by the OpenGL preview and its placement in the object.
+    // Analytic objects return a mesh shared by all of them, built on first
+    // use only : a ray traced run never tessellates them.
+    virtual const Mesh& getPreviewMesh() const { return mesh; }
+    virtual mat4 getPreviewTransform() const { return mat4(); }
+
+    // Hit of p0 + t*V. Meshes only look for triangles with t > tmin, the
+    // other objects return their first root : the caller checks t > tmin.
+    virtual IntersectionValues intersect(const vec4& p0, const vec4& V, double tmin)=0;
+
+    // Any hit with tmin < t < tmax, for shadow rays : no hit record
+    virtual bool occluded(const vec4& p0, const vec4& V, double tmin, double tmax){
+        double t = intersect(p0, V, tmin).t;
+        return t > tmin && t < tmax;
+    }
+
+    // world space axis aligned box enclosing the object (used by the BVH)
+    virtual void getBounds(vec3& bmin, vec3& bmax) const=0;
 
 
 };
@@ -75,12 +94,20 @@ public:
 class Sphere : public Object{
 public:
     
-    Sphere(std::string name, vec3 center= vec3(0., 0., 0.), double radius=1.) : Object(name), center(center), radius(radius) { mesh.makeSubdivisionSphere(8, center, radius); };
+    Sphere(std::string name, vec3 center= vec3(0., 0., 0.), double radius=1.) : Object(name), center(center), radius(radius) { };
     
-    virtual IntersectionValues intersect(vec4 p0, vec4 V);
+    virtual IntersectionValues intersect(const vec4& p0, const vec4& V, double tmin);
+    virtual void getBounds(vec3& bmin, vec3& bmax) const;
+
+    // unit sphere scaled and moved to the sphere
+    virtual const Mesh& getPreviewMesh() const;
+    virtual mat4 getPreviewTransform() const { return Translate(center)*Scale(radius, radius, radius); }
+
+    const vec3& getCenter() const { return center; }
+    double getRadius() const { return radius; }
     
 private:
-    double raySphereIntersection(vec4 p0, vec4 V);
+    double raySphereIntersection(const vec4& p0, const vec4& V);
     vec3 center;
     double radius;
 };
@@ -91,42 +118,76 @@ public:
 
     Square(std::string name, mat4 transform = mat4()) : Object(name) {
 
-        mesh.vertices.resize(6);
-        mesh.uvs.resize(6);
-        mesh.normals.resize(6);
-
-        mesh.vertices[0]=transform*vec4(-1.0, -1.0, 0.0, 1.0);
-        mesh.uvs[0] = vec2(0.0,0.0);
-        mesh.vertices[1]=transform*vec4(1.0, 1.0, 0.0, 1.0);
-        mesh.uvs[1] = vec2(1.0,1.0);
-        mesh.vertices[2]=transform*vec4(1.0, -1.0, 0.0, 1.0);
-        mesh.uvs[2] = vec2(1.0,0.0);
-
-        mesh.vertices[3]=transform*vec4(-1.0, -1.0, 0.0, 1.0);
-        mesh.uvs[3] = vec2(0.0,0.0);
-        mesh.vertices[4]=transform*vec4(1.0, 1.0, 0.0, 1.0);
-        mesh.uvs[4] = vec2(1.0,1.0);
-        mesh.vertices[5]=transform*vec4(-1.0, 1.0, 0.0, 1.0);
-        mesh.uvs[5] = vec2(0.0,1.0);
-
-        point = mesh.vertices[0];
+        // two triangles sharing the diagonal 0-1
+        mesh.vertices.resize(4);
+        mesh.uvs.resize(4);
+        mesh.normals.resize(4);
+        mesh.hasUV = true;
+        mesh.hasNormals = true;
+
+        const vec4 corners[4] = { vec4(-1.0, -1.0, 0.0, 1.0), vec4(1.0, 1.0, 0.0, 1.0),
+                                  vec4(1.0, -1.0, 0.0, 1.0),  vec4(-1.0, 1.0, 0.0, 1.0) };
+        for( unsigned i = 0 ; i < 4 ; i++){
+            vec4 v = transform*corners[i];
+            mesh.vertices[i] = vec3(v.x, v.y, v.z);
+            mesh.uvs[i] = vec2(0.5*(corners[i].x+1.0), 0.5*(corners[i].y+1.0));
+        }
+        const unsigned int indices[6] = { 0, 1, 2, 0, 1, 3 };
+        mesh.indices.assign(indices, indices+6);
+
+        point = vec4(mesh.vertices[0], 1.0);
         TRANINVC = transpose(invert(transform));
         vec4 N (0, 0, 1.0, 0.);
         N = TRANINVC*N;
         normal = vec3(N.x, N.y, N.z);
-        for( unsigned i = 0 ; i < 6 ; i++){
+        for( unsigned i = 0 ; i < 4 ; i++){
             mesh.normals[i]= normal;
         }
 
     };
 
-    virtual IntersectionValues intersect(vec4 p0, vec4 V);
+    virtual IntersectionValues intersect(const vec4& p0, const vec4& V, double tmin);
+    virtual void getBounds(vec3& bmin, vec3& bmax) const;
 
 private:
-    double raySquareIntersection(vec4 p0, vec4 V);
+    double raySquareIntersection(const vec4& p0, const vec4& V);
     double signedTrigArea(const vec4& a, const vec4& b, const vec4& c) const;
     bool insideTriangle(const vec4& a, const vec4& b, const vec4& c, const vec4& p) const;
     bool insideSquare(const vec4& p) const; 
     vec4 point;
     vec3 normal;
 };
+
+
+class TriangleMesh : public Object{
+public:
+
+    // Indexed triangles of source placed in the world by transform. Vertex
+    // normals are interpolated when they come from the file, the geometric
+    // normal is used otherwise.
+    TriangleMesh(std::string name, const Mesh& source, mat4 transform = mat4());
+
+    virtual IntersectionValues intersect(const vec4& p0, const vec4& V, double tmin);
+    virtual bool occluded(const vec4& p0, const vec4& V, double tmin, double tmax);
+    virtual void getBounds(vec3& bmin, vec3& bmax) const;
+
+    unsigned int getNumTri() const { return mesh.getNumTri(); }
+
+private:
+    // watertight ray / triangle test of Woop, Benthin and Wald (JCGT 2013),
+    // no gap nor double hit along shared edges
+    struct RayShear{
+        int kx, ky, kz;
+        double Sx, Sy, Sz;
+        double org[3];
+    };
+    static RayShear shearRay(const vec4& p0, const vec4& V);
+    bool rayTriangleIntersection(const RayShear& ray, unsigned int tri, double tmin, double tmax,
+                                 double& t, double& b0, double& b1, double& b2) const;
+
+    // mesh is in world space, its triangles in the order of bvh.primIndices
+    bool smooth;                        // false : flat shading
+    BVH bvh;
+    vec3 box_min;
+    vec3 box_max;
+};
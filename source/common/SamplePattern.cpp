@@ -0,0 +1,189 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  --- SamplePattern.cpp ---
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "common.h"
+
+static const double twoToMinus32 = 1.0 / 4294967296.0;
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+static const char* const patternNames[] = { "random", "stratified", "halton", "sobol", "bluenoise" };
+
+bool parseSamplePattern(const char* name, SamplePattern& pattern){
+    for (int p = 0; p <= patternBlueNoise; p++) {
+        if (strcmp(name, patternNames[p]) == 0) {
+            pattern = (SamplePattern)p;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* samplePatternName(SamplePattern pattern){
+    return patternNames[pattern];
+}
+
+/* -------------------------------------------------------------------------- */
+/* ------  Element i of a random permutation of [0,l) chosen by p,      ----- */
+/* ------  no table needed (Kensler, Correlated Multi-Jittered Sampling) ----- */
+static unsigned int permute(unsigned int i, unsigned int l, unsigned int p){
+    unsigned int w = l - 1;
+    w |= w >> 1;
+    w |= w >> 2;
+    w |= w >> 4;
+    w |= w >> 8;
+    w |= w >> 16;
+    do {
+        i ^= p;             i *= 0xe170893d;
+        i ^= p >> 16;
+        i ^= (i & w) >> 4;
+        i ^= p >> 8;        i *= 0x0929eb3f;
+        i ^= p >> 23;
+        i ^= (i & w) >> 1;  i *= 1 | p >> 27;
+        i *= 0x6935fa69;
+        i ^= (i & w) >> 11; i *= 0x74dcb303;
+        i ^= (i & w) >> 2;  i *= 0x9e501cc3;
+        i ^= (i & w) >> 2;  i *= 0xc860a3df;
+        i &= w;
+        i ^= i >> 5;
+    } while (i >= l);
+    return (i + p) % l;
+}
+
+static unsigned int hash(unsigned int x){
+    x ^= x >> 16; x *= 0x7feb352d;
+    x ^= x >> 15; x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x;
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+static double radicalInverse3(unsigned int k){
+    double inverse = 0.0, digit = 1.0 / 3.0;
+    for (; k > 0; k /= 3, digit /= 3.0) {
+        inverse += (k % 3) * digit;
+    }
+    return inverse;
+}
+
+static unsigned int reverseBits(unsigned int k){
+    k = (k << 16) | (k >> 16);
+    k = ((k & 0x00ff00ffu) << 8) | ((k & 0xff00ff00u) >> 8);
+    k = ((k & 0x0f0f0f0fu) << 4) | ((k & 0xf0f0f0f0u) >> 4);
+    k = ((k & 0x33333333u) << 2) | ((k & 0xccccccccu) >> 2);
+    k = ((k & 0x55555555u) << 1) | ((k & 0xaaaaaaaau) >> 1);
+    return k;
+}
+
+// second dimension of Sobol, direction numbers of the polynomial x + 1
+static unsigned int sobol2(unsigned int k){
+    unsigned int r = 0;
+    for (unsigned int v = 1u << 31; k != 0; k >>= 1, v ^= v >> 1) {
+        if (k & 1) { r ^= v; }
+    }
+    return r;
+}
+
+static double wrap(double x){ return x >= 1.0 ? x - 1.0 : x; }
+
+/* -------------------------------------------------------------------------- */
+/* ------  Mitchell's best candidate : each new point is the farthest    ----- */
+/* ------  (on the torus) of a few random candidates from the previous  ----- */
+/* ------  ones. Every prefix of the table is evenly spread.            ----- */
+static const unsigned int blueNoiseSize = 256;
+
+static const std::vector < vec2 >& blueNoisePoints(){
+    static const std::vector < vec2 > points = []{
+        std::vector < vec2 > table;
+        table.reserve(blueNoiseSize);
+        Sampler sampler(0, 0, 0x5eed);
+        for (unsigned int k = 0; k < blueNoiseSize; k++) {
+            vec2 best;
+            double bestDistance = -1.0;
+            for (unsigned int c = 0; c < 4 * k + 1; c++) {
+                vec2 candidate(sampler.next1D(), sampler.next1D());
+                double distance = 2.0;
+                for (const vec2& p : table) {
+                    double dx = std::fabs(candidate.x - p.x), dy = std::fabs(candidate.y - p.y);
+                    dx = (std::min)(dx, 1.0 - dx);
+                    dy = (std::min)(dy, 1.0 - dy);
+                    distance = (std::min)(distance, dx*dx + dy*dy);
+                }
+                if (distance > bestDistance) {
+                    bestDistance = distance;
+                    best = candidate;
+                }
+            }
+            table.push_back(best);
+        }
+        return table;
+    }();
+    return points;
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+SampleScramble::SampleScramble(SamplePattern pattern, Sampler& sampler) : pattern(pattern){
+    bits[0] = bits[1] = 0;
+    if (pattern == patternRandom) { return; }
+    bits[0] = (unsigned int)(sampler.next1D() * 4294967296.0);
+    bits[1] = (unsigned int)(sampler.next1D() * 4294967296.0);
+    if (pattern == patternBlueNoise) { blueNoisePoints(); }
+}
+
+SampleScramble SampleScramble::branch(unsigned int n) const{
+    SampleScramble child(*this);
+    child.bits[0] = hash(bits[0] ^ hash(2*n + 1));
+    child.bits[1] = hash(bits[1] ^ hash(2*n + 2));
+    return child;
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+void SampleScramble::point(unsigned int k, unsigned int n, Sampler& sampler, double& u, double& v) const{
+    switch (pattern) {
+    case patternRandom:
+        u = sampler.next1D();
+        v = sampler.next1D();
+        return;
+
+    case patternStratified: {
+        // side x side strata, the last points of a non square n are random
+        unsigned int side = (unsigned int)std::sqrt((double)n);
+        while ((side + 1) * (side + 1) <= n) { side++; }
+        if (k >= side * side) {
+            u = sampler.next1D();
+            v = sampler.next1D();
+            return;
+        }
+        // random order : the first points of an unfinished set stay spread
+        unsigned int stratum = permute(k, side * side, bits[0]);
+        u = ((stratum % side) + sampler.next1D()) / side;
+        v = ((stratum / side) + sampler.next1D()) / side;
+        return;
+    }
+
+    case patternHalton:
+        u = wrap(reverseBits(k) * twoToMinus32 + bits[0] * twoToMinus32);
+        v = wrap(radicalInverse3(k) + bits[1] * twoToMinus32);
+        return;
+
+    case patternSobol:
+        u = (reverseBits(k) ^ bits[0]) * twoToMinus32;
+        v = (sobol2(k) ^ bits[1]) * twoToMinus32;
+        return;
+
+    case patternBlueNoise: {
+        // past the table, the same points shifted again
+        const vec2& p = blueNoisePoints()[k % blueNoiseSize];
+        unsigned int shift = (k < blueNoiseSize) ? 0 : hash(k / blueNoiseSize);
+        u = wrap(p.x + (bits[0] + shift) * twoToMinus32);
+        v = wrap(p.y + (bits[1] + hash(shift)) * twoToMinus32);
+        return;
+    }
+    }
+}
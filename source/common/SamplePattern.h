@@ -0,0 +1,48 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  --- SamplePattern.h ---
+//
+//  Point sets used for the 2D dimensions of the ray tracer (position in the
+//  pixel, position on the area light). Point k of n of a pattern covers the
+//  unit square better than independent random draws : the n points of a
+//  pixel or of a light cell leave no large hole, so the same noise needs
+//  fewer rays. Each set is randomized by a scramble drawn from a Sampler
+//  stream, so neighbouring pixels don't share the same points.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef __SAMPLEPATTERN_H__
+#define __SAMPLEPATTERN_H__
+
+#include "Sampler.h"
+
+enum SamplePattern{
+    patternRandom,     // independent uniform draws from the Sampler stream
+    patternStratified, // jittered grid, strata in a random order
+    patternHalton,     // Halton bases 2 and 3, randomly shifted
+    patternSobol,      // Sobol (0,2)-sequence, random digital shift
+    patternBlueNoise   // best candidate points (no two close points), randomly shifted
+};
+
+// pattern from its name ("random", "stratified", ...), false if unknown
+bool parseSamplePattern(const char* name, SamplePattern& pattern);
+const char* samplePatternName(SamplePattern pattern);
+
+// Randomization shared by the n points of one set
+class SampleScramble{
+public:
+    // draws from sampler, except for patternRandom which doesn't need it
+    SampleScramble(SamplePattern pattern, Sampler& sampler);
+
+    // independent scramble for the sub-set number n (a light cell)
+    SampleScramble branch(unsigned int n) const;
+
+    // point k of n in [0,1)^2, patternRandom draws it from sampler
+    void point(unsigned int k, unsigned int n, Sampler& sampler, double& u, double& v) const;
+
+private:
+    SamplePattern pattern;
+    unsigned int bits[2];
+};
+
+#endif // __SAMPLEPATTERN_H__
@@ -0,0 +1,40 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  --- Sampler.h ---
+//
+//  Counter based random numbers for the ray tracer. Each value is a hash of
+//  (seed, pixel, sample, counter) : every pixel sample owns its own stream,
+//  so a render doesn't depend on the number of threads nor on the order in
+//  which the pixels are traced, and threads share no RNG state.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef __SAMPLER_H__
+#define __SAMPLER_H__
+
+class Sampler{
+public:
+
+    Sampler(unsigned int pixel, unsigned int sample, unsigned int seed=0)
+        : key(mix((((unsigned long long)seed << 32) | pixel) ^ mix(sample))), counter(0) {}
+
+    // next number of the stream, uniform in [0,1)
+    double next1D(){
+        counter++;
+        return (mix(key + counter * 0x9E3779B97F4A7C15ull) >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+private:
+
+    // splitmix64 finalizer
+    static unsigned long long mix(unsigned long long z){
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    unsigned long long key;
+    unsigned long long counter;
+};
+
+#endif // __SAMPLER_H__
@@ -0,0 +1,228 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  --- SphereSet.cpp ---
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "common.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SPHERESET_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define SPHERESET_AVX2
+#else
+#include <cpuid.h>
+#define SPHERESET_AVX2 __attribute__((target("avx2")))
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SPHERESET_SSE2
+#endif
+#endif
+
+namespace {
+
+typedef void (*SphereKernel)(const SphereSet& set, const vec4& p0, const vec4& V,
+                             int first, int count, float* tOut);
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+void scalarKernel(const SphereSet& set, const vec4& p0, const vec4& V,
+                  int first, int count, float* tOut){
+    float a = Angel::dot(V, V);
+    float twoA = 2.0f * a, fourA = 4.0f * a;
+    for (int k = 0; k < count; k++) {
+        int s = first + k;
+        tOut[k] = raySphere(p0.x - set.cx[s], p0.y - set.cy[s], p0.z - set.cz[s],
+                            V.x, V.y, V.z, twoA, fourA, set.r2[s]);
+    }
+}
+
+#ifdef SPHERESET_SSE2
+
+/* -------------------------------------------------------------------------- */
+/* ------ 4 spheres per pass, SSE2 is always there on x86-64            ----- */
+void sse2Kernel(const SphereSet& set, const vec4& p0, const vec4& V,
+                int first, int count, float* tOut){
+    float a = Angel::dot(V, V);
+    const __m128 twoA  = _mm_set1_ps(2.0f * a);
+    const __m128 fourA = _mm_set1_ps(4.0f * a);
+    const __m128 two   = _mm_set1_ps(2.0f);
+    const __m128 zero  = _mm_setzero_ps();
+    const __m128 tol   = _mm_set1_ps(Angel::DivideByZeroTolerance);
+    const __m128 inf   = _mm_set1_ps(std::numeric_limits< float >::infinity());
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 px = _mm_set1_ps(p0.x), py = _mm_set1_ps(p0.y), pz = _mm_set1_ps(p0.z);
+    const __m128 vx = _mm_set1_ps(V.x),  vy = _mm_set1_ps(V.y),  vz = _mm_set1_ps(V.z);
+
+    for (int k = 0; k < count; k += 4) {
+        int s = first + k;
+        __m128 ox = _mm_sub_ps(px, _mm_loadu_ps(&set.cx[s]));
+        __m128 oy = _mm_sub_ps(py, _mm_loadu_ps(&set.cy[s]));
+        __m128 oz = _mm_sub_ps(pz, _mm_loadu_ps(&set.cz[s]));
+        __m128 r2 = _mm_loadu_ps(&set.r2[s]);
+
+        __m128 b = _mm_mul_ps(two, _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, ox), _mm_mul_ps(vy, oy)), _mm_mul_ps(vz, oz)));
+        __m128 c = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ox, ox), _mm_mul_ps(oy, oy)), _mm_mul_ps(oz, oz)), r2);
+        __m128 delta = _mm_sub_ps(_mm_mul_ps(b, b), _mm_mul_ps(fourA, c));
+
+        __m128 minusB = _mm_sub_ps(zero, b);
+        __m128 sq = _mm_sqrt_ps(_mm_max_ps(delta, zero));
+        __m128 t1 = _mm_div_ps(_mm_add_ps(minusB, sq), twoA);
+        __m128 t2 = _mm_div_ps(_mm_sub_ps(minusB, sq), twoA);
+        __m128 bothPositive = _mm_and_ps(_mm_cmpgt_ps(t1, zero), _mm_cmpgt_ps(t2, zero));
+        __m128 t = _mm_or_ps(_mm_and_ps(bothPositive, _mm_min_ps(t1, t2)),
+                             _mm_andnot_ps(bothPositive, _mm_max_ps(t1, t2)));
+
+        __m128 tangent = _mm_cmplt_ps(_mm_and_ps(delta, absMask), tol);
+        t = _mm_or_ps(_mm_and_ps(tangent, _mm_div_ps(minusB, twoA)), _mm_andnot_ps(tangent, t));
+
+        __m128 hit = _mm_cmpge_ps(delta, zero);
+        t = _mm_or_ps(_mm_and_ps(hit, t), _mm_andnot_ps(hit, inf));
+
+        float lanes[4];
+        _mm_storeu_ps(lanes, t);
+        for (int l = 0; l < 4 && k + l < count; l++) { tOut[k + l] = lanes[l]; }
+    }
+}
+
+#endif // SPHERESET_SSE2
+
+#ifdef SPHERESET_X86
+
+/* -------------------------------------------------------------------------- */
+/* ------ 8 spheres per pass                                            ----- */
+SPHERESET_AVX2
+void avx2Kernel(const SphereSet& set, const vec4& p0, const vec4& V,
+                int first, int count, float* tOut){
+    float a = Angel::dot(V, V);
+    const __m256 twoA  = _mm256_set1_ps(2.0f * a);
+    const __m256 fourA = _mm256_set1_ps(4.0f * a);
+    const __m256 two   = _mm256_set1_ps(2.0f);
+    const __m256 zero  = _mm256_setzero_ps();
+    const __m256 tol   = _mm256_set1_ps(Angel::DivideByZeroTolerance);
+    const __m256 inf   = _mm256_set1_ps(std::numeric_limits< float >::infinity());
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    const __m256 px = _mm256_set1_ps(p0.x), py = _mm256_set1_ps(p0.y), pz = _mm256_set1_ps(p0.z);
+    const __m256 vx = _mm256_set1_ps(V.x),  vy = _mm256_set1_ps(V.y),  vz = _mm256_set1_ps(V.z);
+
+    for (int k = 0; k < count; k += 8) {
+        int s = first + k;
+        __m256 ox = _mm256_sub_ps(px, _mm256_loadu_ps(&set.cx[s]));
+        __m256 oy = _mm256_sub_ps(py, _mm256_loadu_ps(&set.cy[s]));
+        __m256 oz = _mm256_sub_ps(pz, _mm256_loadu_ps(&set.cz[s]));
+        __m256 r2 = _mm256_loadu_ps(&set.r2[s]);
+
+        __m256 b = _mm256_mul_ps(two, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vx, ox), _mm256_mul_ps(vy, oy)), _mm256_mul_ps(vz, oz)));
+        __m256 c = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ox, ox), _mm256_mul_ps(oy, oy)), _mm256_mul_ps(oz, oz)), r2);
+        __m256 delta = _mm256_sub_ps(_mm256_mul_ps(b, b), _mm256_mul_ps(fourA, c));
+
+        __m256 minusB = _mm256_sub_ps(zero, b);
+        __m256 sq = _mm256_sqrt_ps(_mm256_max_ps(delta, zero));
+        __m256 t1 = _mm256_div_ps(_mm256_add_ps(minusB, sq), twoA);
+        __m256 t2 = _mm256_div_ps(_mm256_sub_ps(minusB, sq), twoA);
+        __m256 bothPositive = _mm256_and_ps(_mm256_cmp_ps(t1, zero, _CMP_GT_OQ), _mm256_cmp_ps(t2, zero, _CMP_GT_OQ));
+        __m256 t = _mm256_blendv_ps(_mm256_max_ps(t1, t2), _mm256_min_ps(t1, t2), bothPositive);
+
+        __m256 tangent = _mm256_cmp_ps(_mm256_and_ps(delta, absMask), tol, _CMP_LT_OQ);
+        t = _mm256_blendv_ps(t, _mm256_div_ps(minusB, twoA), tangent);
+
+        __m256 hit = _mm256_cmp_ps(delta, zero, _CMP_GE_OQ);
+        t = _mm256_blendv_ps(inf, t, hit);
+
+        float lanes[8];
+        _mm256_storeu_ps(lanes, t);
+        for (int l = 0; l < 8 && k + l < count; l++) { tOut[k + l] = lanes[l]; }
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+bool cpuHasAVX2(){
+    unsigned int eax, ebx, ecx, edx;
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) { return false; }
+    __cpuid(info, 1);
+    ecx = info[2];
+#else
+    if (__get_cpuid_max(0, NULL) < 7) { return false; }
+    __cpuid(1, eax, ebx, ecx, edx);
+#endif
+    // the OS must save the ymm registers (OSXSAVE + AVX, then XCR0 bits 1 and 2)
+    const unsigned int osxsave = 1u << 27, avx = 1u << 28;
+    if ((ecx & (osxsave | avx)) != (osxsave | avx)) { return false; }
+#if defined(_MSC_VER)
+    unsigned long long xcr0 = _xgetbv(0);
+#else
+    unsigned int xlo, xhi;
+    __asm__ ("xgetbv" : "=a"(xlo), "=d"(xhi) : "c"(0));
+    unsigned long long xcr0 = ((unsigned long long)xhi << 32) | xlo;
+#endif
+    if ((xcr0 & 6) != 6) { return false; }
+
+#if defined(_MSC_VER)
+    __cpuidex(info, 7, 0);
+    ebx = info[1];
+#else
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+#endif
+    return (ebx & (1u << 5)) != 0;
+}
+
+#endif // SPHERESET_X86
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+SphereKernel selectKernel(const char*& name){
+#ifdef SPHERESET_X86
+    if (cpuHasAVX2()) { name = "avx2"; return avx2Kernel; }
+#endif
+#ifdef SPHERESET_SSE2
+    name = "sse2";
+    return sse2Kernel;
+#endif
+    name = "scalar";
+    return scalarKernel;
+}
+
+const char*  kernel_name = NULL;
+SphereKernel kernel = selectKernel(kernel_name);
+
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+void SphereSet::reset(int size){
+    // padding so that a full width load never reads past the end
+    int padded = size + laneCount - 1;
+    cx.assign(padded, 0.0f);
+    cy.assign(padded, 0.0f);
+    cz.assign(padded, 0.0f);
+    r2.assign(padded, -std::numeric_limits< float >::infinity());
+    isSphere.assign(size, 0);
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+void SphereSet::setSphere(int slot, const vec3& center, float radius){
+    cx[slot] = center.x;
+    cy[slot] = center.y;
+    cz[slot] = center.z;
+    r2[slot] = radius * radius;
+    isSphere[slot] = 1;
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+void SphereSet::intersect(const vec4& p0, const vec4& V, int first, int count, float* tOut) const{
+    kernel(*this, p0, V, first, count, tOut);
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+const char* SphereSet::kernelName(){
+    return kernel_name;
+}
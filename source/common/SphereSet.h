@@ -0,0 +1,61 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  --- SphereSet.h ---
+//
+//  Structure of arrays copy of the scene spheres, laid out in the same order
+//  as the primitives of the scene BVH so that a whole leaf is tested against
+//  one ray in a single SIMD pass (8 spheres with AVX2, 4 with SSE2).
+//  The kernel is chosen once at startup from CPUID, with a scalar fallback.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef __SPHERESET_H__
+#define __SPHERESET_H__
+
+#include "common.h"
+
+/* -------------------------------------------------------------------------- */
+/* ------ Ray = p0 + t*V against a sphere, (ox,oy,oz) = p0 - center     ----- */
+/* ------ Every kernel performs these float operations in this order so ----- */
+/* ------ that they all return the same t, bit for bit.                 ----- */
+/* ------ Keeps the smallest root if both are positive, the largest one ----- */
+/* ------ otherwise, infinity when missed.                              ----- */
+inline float raySphere(float ox, float oy, float oz,
+                       float vx, float vy, float vz,
+                       float twoA, float fourA, float r2){
+    float b = 2.0f * ((vx*ox + vy*oy) + vz*oz);
+    float c = ((ox*ox + oy*oy) + oz*oz) - r2;
+    float delta = b*b - fourA*c;
+
+    if (!(delta >= 0.0f)) { return std::numeric_limits< float >::infinity(); }
+    // the tolerance rounded to float, as in the _mm*_set1_ps of the SIMD kernels
+    if (std::fabs(delta) < (float)Angel::DivideByZeroTolerance) { return -b / twoA; }
+
+    float sq = std::sqrt(delta);
+    float t1 = (-b + sq) / twoA;
+    float t2 = (-b - sq) / twoA;
+    if (t1 > 0.0f && t2 > 0.0f) { return t1 < t2 ? t1 : t2; }
+    return t1 > t2 ? t1 : t2;
+}
+
+class SphereSet{
+public:
+
+    // Maximum number of spheres handled by one kernel call
+    static const int laneCount = 8;
+
+    std::vector < float > cx, cy, cz, r2;
+    std::vector < unsigned char > isSphere; // slot holds a sphere
+
+    // size slots, all empty (an empty slot is never hit)
+    void reset(int size);
+    void setSphere(int slot, const vec3& center, float radius);
+
+    // t of slots [first, first+count), count <= laneCount, written to tOut
+    void intersect(const vec4& p0, const vec4& V, int first, int count, float* tOut) const;
+
+    // Name of the kernel picked for this CPU
+    static const char* kernelName();
+};
+
+#endif // __SPHERESET_H__
@@ -11,6 +11,7 @@
 
 #include <vector>
 #include <list>
+#include <map>
 #include <limits>
 #include <string.h>
 #include <assert.h>
@@ -38,6 +39,8 @@
 // Define cout for Windows 
 #if defined(_WIN32)
     #include "debugapi.h"
+#else
+    #define OutputDebugString(msg) fputs((msg), stderr)
 #endif
 //----------------------------------------------------------------------------
 //
@@ -296,7 +299,12 @@ static void check_program_link(GLuint program){
 
 #include "CheckError.h"
 #include "ObjMesh.h"
+#include "BVH.h"
 #include "Object.h"
+#include "Camera.h"
+#include "SphereSet.h"
+#include "Sampler.h"
+#include "SamplePattern.h"
 #include "Trackball.h"
 
 
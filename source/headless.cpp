@@ -0,0 +1,321 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  --- headless.cpp ---
+//
+//  Batch renderer : ray traces one of the scenes without opening a window
+//  or creating a GL context, writes the png and exits.
+//  Returns 0 on success, 1 if the image could not be written and 2 on
+//  invalid arguments.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "raytrace.h"
+#include "rendersink.h"
+#include "MappedFile.h"
+#include "pngdec.h"
+#include <omp.h>
+#include <chrono>
+
+using namespace Angel;
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+static void usage(const char* program){
+    std::cerr << "usage: " << program << " [options]\n"
+              << "  --scene <1-4>      1 sphere, 2 square, 3 cornell box, 4 random cornell box (3)\n"
+              << "  --obj <file>       adds an OBJ model standing in the middle of the scene\n"
+              << "  --width <px>       image width (768)\n"
+              << "  --height <px>      image height (768)\n"
+              << "  --spp <n>          anti-aliasing rays per pixel (" << renderSettings.nraysample << ")\n"
+              << "  --min-spp <n>      adaptive anti-aliasing : first rays of every pixel, up to --spp, 0 off (" << renderSettings.nminsample << ")\n"
+              << "  --noise <x>        adaptive : pixel done when its error on screen is below (" << renderSettings.noiseThreshold << ")\n"
+              << "  --heatmap <file>   png of the rays spent per pixel, blue few to red --spp\n"
+              << "  --aa-pattern <p>   anti-aliasing positions : random, stratified, halton, sobol or bluenoise (" << samplePatternName(renderSettings.pixelPattern) << ")\n"
+              << "  --shadow <n>       shadow rays per hit point, 1 for hard shadows (" << renderSettings.nshadowsample << ")\n"
+              << "  --shadow-batch <n> first shadow rays, the rest only in the penumbra (" << renderSettings.nshadowbatch << ")\n"
+              << "  --light-pattern <p> shadow ray positions on the light, same patterns (" << samplePatternName(renderSettings.lightPattern) << ")\n"
+              << "  --depth <n>        maximum ray depth, at most " << maxRayDepth << " (" << renderSettings.maxDepth << ")\n"
+              << "  --seed <n>         random streams seed, same seed : same image (" << renderSettings.seed << ")\n"
+              << "  --min-throughput <x> secondary rays weighing less are pruned, 0 never (" << renderSettings.minThroughput << ")\n"
+              << "  --pruning <mode>   roulette (kept at random, scaled up) or cut (roulette)\n"
+              << "  --threads <n>      render threads (all cores)\n"
+              << "  --output <file>    png file to write, linear floats if it ends with .pfm (output.png)\n"
+              << "  --checkpoint <file> saves the finished tiles every --checkpoint-interval seconds\n"
+              << "  --checkpoint-interval <s> (60, at least " << minCheckpointInterval << ")\n"
+              << "  --resume <file>    continues the render saved in this checkpoint (same options)\n"
+              << "  --stream <file>    instead of --output, png or tiled .rtt written tile by tile, no full frame in memory\n"
+              << "  --convert <file>   writes a .pfm or .rtt render to --output, no render\n"
+              << "  --bench-obj <file> OBJ loading throughput of both parsers, no render\n"
+              << "  --bench-png <file> encodes this png classic, heuristic and parallel to --output, no render\n";
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+static bool parseInt(const char* text, int minValue, int& value){
+    char* end = NULL;
+    long v = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || v < minValue) { return false; }
+    value = (int)v;
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+static bool parseDouble(const char* text, double minValue, double& value){
+    char* end = NULL;
+    double v = strtod(text, &end);
+    if (end == text || *end != '\0' || !(v >= minValue)) { return false; }
+    value = v;
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+/* ------  Best of a few runs of the original and the parallel OBJ   -------- */
+/* ------  parsers (file read included, no cache)                     -------- */
+static int benchObj(const char* path){
+    const int runs = 3;
+    double simpleSeconds = 1e30, parallelSeconds = 1e30;
+    size_t simpleTriangles = 0, parallelTriangles = 0, bytes = 0;
+
+    for (int r = 0; r < runs; r++) {
+        auto start = std::chrono::steady_clock::now();
+        Mesh mesh;
+        if (!mesh.parseOBJSimple(path)) {
+            std::cerr << "original parser : can't read " << path << std::endl;
+            simpleSeconds = 0.0;
+            break;
+        }
+        simpleSeconds = (std::min)(simpleSeconds, std::chrono::duration < double >(std::chrono::steady_clock::now() - start).count());
+        simpleTriangles = mesh.getNumTri();
+    }
+
+    for (int r = 0; r < runs; r++) {
+        auto start = std::chrono::steady_clock::now();
+        MappedFile file;
+        Mesh mesh;
+        if (!file.open(path) || !mesh.parseOBJ(file.data(), file.size())) {
+            std::cerr << "parallel parser : can't read " << path << std::endl;
+            return 1;
+        }
+        parallelSeconds = (std::min)(parallelSeconds, std::chrono::duration < double >(std::chrono::steady_clock::now() - start).count());
+        parallelTriangles = mesh.getNumTri();
+        bytes = file.size();
+    }
+
+    double megabytes = bytes / (1024.0 * 1024.0);
+    if (simpleSeconds > 0.0) {
+        std::cerr << "original : " << simpleTriangles << " triangles, " << simpleSeconds << "s, "
+                  << megabytes / simpleSeconds << " MB/s" << std::endl;
+    }
+    std::cerr << "parallel : " << parallelTriangles << " triangles, " << parallelSeconds << "s, "
+              << megabytes / parallelSeconds << " MB/s on " << omp_get_max_threads() << " threads" << std::endl;
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+/* ------  RGBA 8 bits copy of a decoded png                          -------- */
+class DecodedImage : public cmps3120::png_receptor{
+public:
+    unsigned int width, height;
+    std::vector < unsigned char > rgba;
+
+    DecodedImage() : width(0), height(0) {}
+    void set_header(cmps3120::png_header header){
+        width  = header.width;
+        height = header.height;
+        rgba.assign(4 * (size_t)width * height, 0);
+    }
+    void set_pixel(unsigned int x, unsigned int y, unsigned int level, cmps3120::png_pixel v){
+        unsigned char* p = &rgba[4 * ((size_t)y * width + x)];
+        p[0] = v.r >> 8;
+        p[1] = v.g >> 8;
+        p[2] = v.b >> 8;
+        p[3] = v.a >> 8;
+    }
+};
+
+static bool decodePNG(const char* path, DecodedImage& image){
+    cmps3120::png_decoder decoder;
+    decoder.set_receptor(&image);
+    return decoder.read_file(path) == cmps3120::PNG_DONE && !image.rgba.empty();
+}
+
+/* -------------------------------------------------------------------------- */
+/* ------  Best of a few writes of a png with each encoder mode, and   -------- */
+/* ------  size of the file written                                   -------- */
+static int benchPNG(const char* path, const char* output){
+    DecodedImage image;
+    if (!decodePNG(path, image)) {
+        std::cerr << "can't read " << path << std::endl;
+        return 2;
+    }
+
+    const int runs = 3;
+    const double megabytes = image.rgba.size() / (1024.0 * 1024.0);
+    const cmps3120::png_enc_mode modes[3] = { cmps3120::png_enc_classic, cmps3120::png_enc_heuristic,
+                                              cmps3120::png_enc_heuristic };
+    const int threads[3] = { 1, 1, omp_get_max_threads() };
+    const char* names[3] = { "classic  ", "heuristic", "parallel " };
+    for (int m = 0; m < 3; m++) {
+        double seconds = 1e30;
+        for (int r = 0; r < runs; r++) {
+            auto start = std::chrono::steady_clock::now();
+            if (!write_image(output, &image.rgba[0], image.width, image.height, 4, modes[m], threads[m])) { return 1; }
+            seconds = (std::min)(seconds, std::chrono::duration < double >(std::chrono::steady_clock::now() - start).count());
+        }
+
+        DecodedImage written;
+        bool same = decodePNG(output, written) && written.rgba == image.rgba;
+        FILE* file = fopen(output, "rb");
+        long bytes = 0;
+        if (file != NULL) {
+            fseek(file, 0, SEEK_END);
+            bytes = ftell(file);
+            fclose(file);
+        }
+        std::cerr << names[m] << " : " << bytes << " bytes, " << seconds << "s, "
+                  << megabytes / seconds << " MB/s on " << threads[m] << " thread" << (threads[m] > 1 ? "s" : "")
+                  << (same ? "" : " (DECODED IMAGE DIFFERS)") << std::endl;
+    }
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+int main(int argc, char** argv){
+
+    int scene   = 3;
+    int width   = 768;
+    int height  = 768;
+    int spp     = renderSettings.nraysample;
+    int threads = 0;
+    std::string output = "output.png";
+    std::string obj;
+    std::string heatmap;
+    std::string benchObjPath;
+    std::string benchPngPath;
+    std::string convert;
+    std::string stream;
+    CheckpointSettings checkpoint = { "", 60.0, false, "" };
+
+    for (int a = 1; a < argc; a++) {
+        std::string arg = argv[a];
+        if (arg == "-h" || arg == "--help") {
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+        }
+        if (a + 1 >= argc) {
+            std::cerr << "missing value for " << arg << std::endl;
+            usage(argv[0]);
+            return 2;
+        }
+        const char* value = argv[++a];
+
+        bool valid = true;
+        if      (arg == "--scene")   { valid = parseInt(value, 1, scene) && scene <= 4; }
+        else if (arg == "--width")   { valid = parseInt(value, 1, width); }
+        else if (arg == "--height")  { valid = parseInt(value, 1, height); }
+        else if (arg == "--spp")     { valid = parseInt(value, 1, spp); }
+        else if (arg == "--min-spp") { int n = 0; valid = parseInt(value, 0, n); renderSettings.nminsample = n; }
+        else if (arg == "--noise")   { valid = parseDouble(value, 0.0, renderSettings.noiseThreshold); }
+        else if (arg == "--heatmap") { heatmap = value; }
+        else if (arg == "--aa-pattern") { valid = parseSamplePattern(value, renderSettings.pixelPattern); }
+        else if (arg == "--light-pattern") { valid = parseSamplePattern(value, renderSettings.lightPattern); }
+        else if (arg == "--shadow")  { valid = parseInt(value, 1, renderSettings.nshadowsample); }
+        else if (arg == "--shadow-batch") { valid = parseInt(value, 1, renderSettings.nshadowbatch); }
+        else if (arg == "--depth")   { valid = parseInt(value, 0, renderSettings.maxDepth) && renderSettings.maxDepth <= maxRayDepth; }
+        else if (arg == "--seed")    { int seed = 0; valid = parseInt(value, 0, seed); renderSettings.seed = seed; }
+        else if (arg == "--min-throughput") { valid = parseDouble(value, 0.0, renderSettings.minThroughput); }
+        else if (arg == "--pruning") {
+            std::string mode = value;
+            valid = (mode == "roulette" || mode == "cut");
+            renderSettings.roulette = (mode != "cut");
+        }
+        else if (arg == "--threads") { valid = parseInt(value, 1, threads); }
+        else if (arg == "--output")  { output = value; }
+        else if (arg == "--stream")  { stream = value; }
+        else if (arg == "--obj")     { obj = value; }
+        else if (arg == "--bench-obj") { benchObjPath = value; }
+        else if (arg == "--bench-png") { benchPngPath = value; }
+        else if (arg == "--convert") { convert = value; }
+        else if (arg == "--checkpoint") { checkpoint.path = value; }
+        else if (arg == "--checkpoint-interval") { valid = parseDouble(value, minCheckpointInterval, checkpoint.interval); }
+        else if (arg == "--resume")  { checkpoint.path = value; checkpoint.resume = true; }
+        else {
+            std::cerr << "unknown option " << arg << std::endl;
+            usage(argv[0]);
+            return 2;
+        }
+
+        if (!valid) {
+            std::cerr << "invalid value '" << value << "' for " << arg << std::endl;
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    renderSettings.nraysample = spp;
+    if (threads > 0) { omp_set_num_threads(threads); }
+
+    if (!benchObjPath.empty()) {
+        return benchObj(benchObjPath.c_str());
+    }
+    if (!benchPngPath.empty()) {
+        return benchPNG(benchPngPath.c_str(), output.c_str());
+    }
+
+    if (!convert.empty() && convert.size() >= 4 && convert.compare(convert.size() - 4, 4, ".rtt") == 0) {
+        if (!convertTiledRaw(convert.c_str(), output.c_str())) {
+            std::cerr << "can't convert " << convert << std::endl;
+            return 1;
+        }
+        return EXIT_SUCCESS;
+    }
+    if (!convert.empty()) {
+        std::vector < float > rgb;
+        int w = 0, h = 0;
+        if (!read_pfm(convert.c_str(), rgb, w, h)) {
+            std::cerr << "can't read " << convert << std::endl;
+            return 2;
+        }
+        return writeRender(output.c_str(), &rgb[0], 1, w, h) ? EXIT_SUCCESS : 1;
+    }
+
+    std::unique_ptr < RenderSink > sink;
+    if (!stream.empty()) {
+        sink = createRenderSink(stream);
+        if (!sink) {
+            std::cerr << "a .pfm is written bottom row first and can't be streamed, use .rtt then --convert" << std::endl;
+            return 2;
+        }
+        if (!heatmap.empty() || !checkpoint.path.empty()) {
+            std::cerr << "--stream keeps no full frame : no --heatmap, --checkpoint nor --resume" << std::endl;
+            return 2;
+        }
+    }
+
+    // scenes are numbered as the keys of the viewer
+    int sceneId = scene - 1;
+    initScene(sceneId);
+
+    // largest side 2 on the floor of the cornell boxes
+    if (!obj.empty() && !addObjModel(obj.c_str(), vec3(0.0, -1.0, 0.0), 2.0f)) {
+        std::cerr << "can't load " << obj << std::endl;
+        return 2;
+    }
+
+    // same view as the viewer before any trackball interaction
+    mat4 modelView  = Translate(-cameraPosition);
+    mat4 projection = sceneProjection(sceneId, GLfloat(width) / height);
+    Camera camera(modelView, projection, width, height);
+
+    if (sink) {
+        return rayTraceStreamed(camera, *sink) ? EXIT_SUCCESS : 1;
+    }
+
+    checkpoint.job = "scene " + std::to_string(scene) + " obj " + obj;
+    bool written = rayTrace(camera, output.c_str(), heatmap.empty() ? NULL : heatmap.c_str(),
+                            checkpoint.path.empty() ? NULL : &checkpoint);
+
+    return written ? EXIT_SUCCESS : 1;
+}
@@ -0,0 +1,74 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  --- progressive.cpp ---
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "progressive.h"
+#include <chrono>
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+void ProgressiveRender::start(const Camera& camera, const std::string& filename){
+    cancel();
+
+    this->camera = camera;
+    this->filename = filename;
+    {
+        std::lock_guard < std::mutex > lock(mutex);
+        shown.assign(3 * camera.getWidth() * camera.getHeight(), 0.0f);
+        shownPasses = 0;
+        fetchedPasses = 0;
+    }
+
+    cancelled = false;
+    started = true;
+    worker = std::thread(&ProgressiveRender::run, this);
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+void ProgressiveRender::cancel(){
+    cancelled = true;
+    if (worker.joinable()) { worker.join(); }
+    started = false;
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+bool ProgressiveRender::fetch(std::vector < float >& rgb, int& width, int& height, unsigned int& passes){
+    std::lock_guard < std::mutex > lock(mutex);
+    if (shownPasses == 0 || shownPasses == fetchedPasses) { return false; }
+
+    width  = camera.getWidth();
+    height = camera.getHeight();
+    passes = shownPasses;
+    rgb = shown;
+
+    fetchedPasses = shownPasses;
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+/* ------  Render thread : one sample per pixel and per pass        --------- */
+void ProgressiveRender::run(){
+    const unsigned int npasses = renderSettings.nraysample;
+    const int npixels = camera.getWidth() * camera.getHeight();
+    std::vector < float > accum(3 * npixels, 0.0f);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (unsigned int pass = 0; pass < npasses; pass++) {
+        // a cancelled pass is never shown
+        if (!renderSamples(camera, pass, pass + 1, &accum[0], &cancelled)) { return; }
+
+        std::lock_guard < std::mutex > lock(mutex);
+        shown = accum;
+        shownPasses = pass + 1;
+    }
+
+    double seconds = std::chrono::duration < double >(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "progressive render : " << npasses << " passes in " << seconds << "s." << std::endl;
+
+    writeRender(filename.c_str(), &accum[0], npasses, camera.getWidth(), camera.getHeight());
+}
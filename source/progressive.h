@@ -0,0 +1,58 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  --- progressive.h ---
+//
+//  Progressive ray tracing for the viewer : a background thread renders one
+//  anti-aliasing sample per pixel and per pass, and accumulates the passes
+//  in a float framebuffer. The GL loop fetches the latest image every frame,
+//  so a view can be judged after a few passes. The png is written when the
+//  last of the renderSettings.nraysample passes is done.
+//  Only the render thread reads the scene : cancel() before changing it.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef __PROGRESSIVE_H__
+#define __PROGRESSIVE_H__
+
+#include "raytrace.h"
+#include <thread>
+#include <mutex>
+
+class ProgressiveRender{
+public:
+
+    ProgressiveRender(): started(false), cancelled(false), shownPasses(0), fetchedPasses(0) {}
+    ~ProgressiveRender(){ cancel(); }
+
+    // Cancels the current render and restarts from the first pass
+    void start(const Camera& camera, const std::string& filename);
+
+    // Stops the render thread and waits for it
+    void cancel();
+
+    // True if started with this camera (running or finished) and not cancelled
+    bool renders(const Camera& view) const { return started && camera == view; }
+
+    // Sum of the samples of the latest pass (rgb floats) if it finished
+    // since the last call
+    bool fetch(std::vector < float >& rgb, int& width, int& height, unsigned int& passes);
+
+private:
+
+    void run();
+
+    Camera camera;
+    std::string filename;
+    bool started;
+
+    std::thread worker;
+    std::atomic < bool > cancelled;
+
+    // last finished pass, shared with the render thread
+    std::mutex mutex;
+    std::vector < float > shown;
+    unsigned int shownPasses;
+    unsigned int fetchedPasses;
+};
+
+#endif // __PROGRESSIVE_H__
@@ -0,0 +1,1097 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  --- raytrace.cpp ---
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "raytrace.h"
+#include "checkpoint.h"
+#include "rendersink.h"
+#include <omp.h> 
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+
+std::vector < Object * > sceneObjects;
+BVH sceneBVH;
+SphereSet sceneSpheres;
+point4 lightPosition;
+color4 lightColor;
+point4 cameraPosition;
+
+RenderSettings renderSettings = {
+    64,  // nraysample
+    256, // nshadowsample
+    16,  // nshadowbatch
+    8,   // maxDepth
+    0,   // seed
+    0.05,// minThroughput
+    true,// roulette
+    0,   // nminsample
+    0.01,// noiseThreshold
+    patternRandom, // pixelPattern
+    patternRandom  // lightPattern
+};
+
+//Relative error allowed to the float t of the sphere kernels : they only cull,
+//the hit record and the shadow tests near the bounds are computed in double
+constexpr double sphereCullSlack = 1e-3;
+
+//Side in pixels of the square tiles handed to the render threads
+constexpr int tileSize = 32;
+
+//Shadow rays statistics of the current render
+std::atomic < long long > shadowRayCount(0);
+std::atomic < long long > shadowHitCount(0);
+
+//Secondary rays statistics of the current render
+std::atomic < long long > secondaryRayCount(0);
+std::atomic < long long > prunedRayCount(0);
+
+//Counted by each thread during a tile, added to the totals once the tile is done
+struct TileRayCounts{
+    long long shadowRays, shadowHits, secondaryRays, prunedRays;
+};
+static thread_local TileRayCounts tileRayCounts = { 0, 0, 0, 0 };
+
+static void addTileRayCounts(){
+    shadowRayCount    += tileRayCounts.shadowRays;
+    shadowHitCount    += tileRayCounts.shadowHits;
+    secondaryRayCount += tileRayCounts.secondaryRays;
+    prunedRayCount    += tileRayCounts.prunedRays;
+    tileRayCounts = TileRayCounts();
+}
+
+/* ------------------------------------------------------- */
+/* -- PNG receptor class for use with pngdecode library -- */
+class rayTraceReceptor : public cmps3120::png_receptor
+{
+private:
+    const unsigned char *buffer;
+    unsigned int width;
+    unsigned int height;
+    int channels;
+
+public:
+    rayTraceReceptor(const unsigned char *use_buffer,
+                     unsigned int width,
+                     unsigned int height,
+                     int channels){
+        this->buffer = use_buffer;
+        this->width = width;
+        this->height = height;
+        this->channels = channels;
+    }
+    cmps3120::png_header get_header(){
+        cmps3120::png_header header;
+        header.width = width;
+        header.height = height;
+        header.bit_depth = 8;
+        switch (channels)
+        {
+        case 1:
+            header.color_type = cmps3120::PNG_GRAYSCALE;break;
+        case 2:
+            header.color_type = cmps3120::PNG_GRAYSCALE_ALPHA;break;
+        case 3:
+            header.color_type = cmps3120::PNG_RGB;break;
+        default:
+            header.color_type = cmps3120::PNG_RGBA;break;
+        }
+        return header;
+    }
+    cmps3120::png_pixel get_pixel(unsigned int x, unsigned int y, unsigned int level){
+        cmps3120::png_pixel pixel;
+        unsigned int idx = y*width+x;
+        /* pngdecode wants 16-bit color values */
+        pixel.r = buffer[4*idx]*257;
+        pixel.g = buffer[4*idx+1]*257;
+        pixel.b = buffer[4*idx+2]*257;
+        pixel.a = buffer[4*idx+3]*257;
+        return pixel;
+    }
+    const unsigned char* get_row(unsigned int y){
+        /* the buffer is RGBA : as stored in the file with 4 channels */
+        return (channels == 4) ? buffer + 4*(size_t)y*width : NULL;
+    }
+};
+
+/* -------------------------------------------------------------------------- */
+/* ----------------------  Write Image to Disk  ----------------------------- */
+bool write_image(const char* filename, const unsigned char *Src,
+                 int Width, int Height, int channels, cmps3120::png_enc_mode mode, int threads){
+    cmps3120::png_encoder the_encoder;
+    cmps3120::png_error result;
+    rayTraceReceptor image(Src,Width,Height,channels);
+    the_encoder.set_mode(mode);
+    the_encoder.set_threads(threads > 0 ? threads : omp_get_max_threads());
+    the_encoder.set_receptor(&image);
+    result = the_encoder.write_file(filename);
+    if (result == cmps3120::PNG_DONE) {
+        std::cerr << "finished writing " << filename << "." << std::endl;
+#if defined(_WIN32)
+        std::string msg = "finished writing ";
+        msg += filename;
+        msg += "\n"; 
+        OutputDebugString(msg.c_str());
+#endif
+    }
+    else {
+        std::cerr << "write to " << filename << " returned error code " << result << "." << std::endl;
+    }
+    return result==cmps3120::PNG_DONE;
+}
+
+
+/* -------------------------------------------------------------------------- */
+/* ---------  Closest object hit by p0 + t*dir with t > tmin   -------------- */
+/* ---------  ID_ is -1 when nothing is hit                     -------------- */
+/* ---------  skipTransparent ignores objects with Kt > 0.8     -------------- */
+Object::IntersectionValues closestHit(const vec4& p0, const vec4& dir, double tmin, bool skipTransparent){
+    Object::IntersectionValues closest;
+    closest.t = std::numeric_limits< double >::infinity();
+    closest.ID_ = -1;
+
+    sceneBVH.traverseLeaves(p0, dir, closest.t, [&](int first, int count){
+        float tSphere[SphereSet::laneCount];
+
+        for (int start = first; start < first + count; start += SphereSet::laneCount) {
+            int n = (std::min)(SphereSet::laneCount, first + count - start);
+
+            // all the spheres of the leaf in one pass
+            sceneSpheres.intersect(p0, dir, start, n, tSphere);
+
+            for (int k = 0; k < n; k++) {
+                int slot = start + k;
+                unsigned int i = sceneBVH.primIndices[slot];
+                if (skipTransparent && transparentToShadows(sceneObjects[i])) {
+                    continue;
+                }
+
+                // spheres : full hit record only for what may be a closer hit
+                if (sceneSpheres.isSphere[slot] &&
+                    !(std::fabs(tSphere[k]) * (1.0 - sphereCullSlack) < closest.t &&
+                      tSphere[k] * (1.0 + sphereCullSlack) > tmin)) {
+                    continue;
+                }
+
+                Object::IntersectionValues inter = sceneObjects[i]->intersect(p0, dir, tmin);
+                if (std::fabs(inter.t) < closest.t && inter.t > tmin) {
+                    closest = inter;
+                    closest.ID_ = i;
+                }
+            }
+        }
+        return false;
+    });
+
+    return closest;
+}
+
+/* -------------------------------------------------------------------------- */
+/* ---------  Visibility : true as soon as an object that casts    ---------- */
+/* ---------  shadows is hit by p0 + t*dir with tmin < t < tmax    ---------- */
+bool sceneOccluded(const vec4& p0, const vec4& dir, double tmin, double tmax){
+    bool occluded = false;
+
+    sceneBVH.traverseLeaves(p0, dir, tmax, [&](int first, int count){
+        float tSphere[SphereSet::laneCount];
+
+        for (int start = first; start < first + count; start += SphereSet::laneCount) {
+            int n = (std::min)(SphereSet::laneCount, first + count - start);
+            sceneSpheres.intersect(p0, dir, start, n, tSphere);
+
+            for (int k = 0; k < n; k++) {
+                int slot = start + k;
+                unsigned int i = sceneBVH.primIndices[slot];
+                if (transparentToShadows(sceneObjects[i])) {
+                    continue;
+                }
+
+                // spheres : the float t decides when it is clearly inside or
+                // outside (tmin, tmax), the double test near the bounds
+                bool hit;
+                if (sceneSpheres.isSphere[slot]) {
+                    const double t = tSphere[k];
+                    if (!(t * (1.0 + sphereCullSlack) > tmin && t * (1.0 - sphereCullSlack) < tmax)) {
+                        continue;
+                    }
+                    hit = (t * (1.0 - sphereCullSlack) > tmin && t * (1.0 + sphereCullSlack) < tmax)
+                       || sceneObjects[i]->occluded(p0, dir, tmin, tmax);
+                }
+                else {
+                    hit = sceneObjects[i]->occluded(p0, dir, tmin, tmax);
+                }
+                if (hit) {
+                    occluded = true;
+                    return true; // stop the traversal
+                }
+            }
+        }
+        return false;
+    });
+
+    return occluded;
+}
+
+/* -------------------------------------------------------------------------- */
+/* ---------  Some debugging code: cast Ray = p0 + t*dir  ------------------- */
+/* ---------  and print out what it hits =                ------------------- */
+void castRayDebug(vec4 p0, vec4 dir){
+
+    Object::IntersectionValues closest;
+    closest.ID_ = -1; 
+    closest.t = std::numeric_limits< double >::infinity(); 
+
+    // every object whose box is crossed by the ray : never shrink the range
+    const double tmax = std::numeric_limits< double >::infinity();
+    sceneBVH.traverse(p0, dir, tmax, [&](unsigned int i){
+        Object::IntersectionValues inter = sceneObjects[i]->intersect(p0, dir, EPSILON);
+        inter.ID_ = i;
+
+        if(inter.t != std::numeric_limits< double >::infinity()){
+            
+            vec4 L = lightPosition-inter.P;
+            L  = normalize(L);
+
+            const std::string& name = sceneObjects[i]->name;
+            std::string message = "Hit " + name + " " + std::to_string(inter.ID_) + "\n";
+            message += "P: " + inter.P.to_string() + "\n";
+            message += "N: " + inter.N.to_string() + "\n";
+            message += "L: " + L.to_string() + "\n";
+            message += "t: " + std::to_string(inter.t) + "\n";
+            message += "Name : " + name + "\n"; 
+            OutputDebugString(message.c_str()); 
+
+            if (std::fabs(inter.t) < closest.t && inter.t > 0.0)
+            {
+                closest.t = inter.t; 
+                closest.ID_ = inter.ID_; 
+            }
+   
+            OutputDebugString("---------------------\n");
+        }
+        return false;
+    });
+
+    OutputDebugString("~~~~~~~~~~~~~~\n");
+
+    if (closest.ID_ != -1) {
+        std::string message = "Closest " + sceneObjects[closest.ID_]->name + "\n";
+        OutputDebugString(message.c_str());
+    }
+
+    OutputDebugString("=============================\n");
+    
+
+}
+
+/* -------------------------------------------------------------------------- */
+
+// utility function 
+void clampColor(vec4& color) {
+    color.x = (std::min)(1.0, (double)color.x); 
+    color.y = (std::min)(1.0, (double)color.y);
+    color.z = (std::min)(1.0, (double)color.z);
+    color.w = 1.0;
+}
+
+void equalizeColor(vec4& color) 
+{
+    double colorMax = (std::max)((std::max)(color.x, color.y), color.z);
+
+    if (colorMax > 1.0)
+    {
+        color.x /= colorMax;
+        color.y /= colorMax;
+        color.z /= colorMax;
+    }
+
+    color.w = 1.0;
+}
+
+
+
+// shadow Feeler : true if hits any object before reaching lightsource 
+bool shadowFeeler(const vec4& p0, const vec4& lightp){
+    // Light Direction, not normalized : the light is at t = 1
+    vec4 L = lightp - p0;
+    L.w = 0.0;
+
+    // Cast a single ray towards Light 
+    // -------------------------------
+    // Any object between p0 and the light is enough, no need for the closest one
+    // transparent material doesn't cast shadow 
+    //  Shadow Acne : move towards light
+    return sceneOccluded(p0, L, EPSILON, 1.0);
+}
+
+// Soft Shadows from an area lightsource (uniform sampling of source in square 5.0 x 5.0)
+// advise : Nsamples = 128 or 256 to get interesting render
+// Adaptive : the source is cut into a grid of about nshadowbatch cells and one
+// jittered ray is cast per cell. Only cells whose visibility differs from a
+// neighbour's (a shadow edge crosses them) get their share of the Nsamples
+// budget, fully lit or fully shadowed regions stop after the first batch.
+const double lightSide = 5.0;
+
+int shadowGridSide(int Nsamples){
+    int side = (int)std::sqrt((double)(std::min)(renderSettings.nshadowbatch, Nsamples));
+    return (std::min)((std::max)(side, 1), maxShadowGridSide);
+}
+
+// light position k of cell c (generated on the fly, no need to store them)
+vec4 lightSample(int c, int side, unsigned int k, unsigned int n, const SampleScramble& scramble, Sampler& sampler){
+    const double cell = lightSide / side;
+    double u, v;
+    scramble.branch(c).point(k, n, sampler, u, v);
+    double x = (-lightSide / 2.0) + ((c % side) + u) * cell;
+    double z = (-lightSide / 2.0) + ((c / side) + v) * cell;
+    return lightPosition + vec4(x, 0.0, z, 0.0);
+}
+
+bool penumbraCell(const bool* inShadow, int c, int side){
+    int cx = c % side, cz = c / side;
+    return (cx > 0        && inShadow[c - 1]    != inShadow[c])
+        || (cx < side - 1 && inShadow[c + 1]    != inShadow[c])
+        || (cz > 0        && inShadow[c - side] != inShadow[c])
+        || (cz < side - 1 && inShadow[c + side] != inShadow[c]);
+}
+
+float softShadow(const vec4& p0, Sampler& sampler, const int& Nsamples=10)
+{
+    // hard shadows : the light center only
+    if (Nsamples <= 1) {
+        tileRayCounts.shadowRays++;
+        tileRayCounts.shadowHits++;
+        return shadowFeeler(p0, lightPosition) ? 1.0f : 0.0f;
+    }
+
+    const int side = shadowGridSide(Nsamples);
+    const int ncells = side * side;
+    // Penumbra : rays a cell would get with the whole budget
+    const int perCell = Nsamples / ncells;
+    const unsigned int npoints = (std::max)(perCell, 1);
+    SampleScramble scramble(renderSettings.lightPattern, sampler);
+
+    // First batch : one ray per cell, the first point of the cell
+    bool inShadow[maxShadowGridSide * maxShadowGridSide];
+    for (int c = 0; c < ncells; c++) {
+        inShadow[c] = shadowFeeler(p0, lightSample(c, side, 0, npoints, scramble, sampler));
+    }
+
+    int nrays = ncells;
+    float shadowed = 0.0f;
+    for (int c = 0; c < ncells; c++) {
+        if (!penumbraCell(inShadow, c, side) || perCell <= 1) {
+            shadowed += inShadow[c] ? 1.0f : 0.0f;
+            continue;
+        }
+
+        int nInShadows = inShadow[c] ? 1 : 0;
+        for (int k = 1; k < perCell; k++) {
+            if (shadowFeeler(p0, lightSample(c, side, k, npoints, scramble, sampler))) { nInShadows++; }
+        }
+        nrays += perCell - 1;
+        shadowed += (float)nInShadows / (float)perCell;
+    }
+
+    tileRayCounts.shadowRays += nrays;
+    tileRayCounts.shadowHits++;
+
+    return shadowed / (float)ncells;
+}
+
+
+/* -------------------------------------------------------------------------- */
+/* ----------  Should a secondary ray of this throughput be traced ? -------- */
+/* ----------  Below renderSettings.minThroughput it is cut, or kept -------- */
+/* ----------  with probability throughput / minThroughput and its   -------- */
+/* ----------  color scaled by 1 / probability (russian roulette).   -------- */
+/* ----------  The colors are clamped on the way up : bright scaled  -------- */
+/* ----------  branches lose energy, the roulette is not unbiased    -------- */
+bool traceBranch(double throughput, Sampler& sampler, double& scale){
+    scale = 1.0;
+    if (throughput >= renderSettings.minThroughput) { return true; }
+
+    if (renderSettings.roulette) {
+        double survive = throughput / renderSettings.minThroughput;
+        if (sampler.next1D() < survive) {
+            scale = 1.0 / survive;
+            return true;
+        }
+    }
+    tileRayCounts.prunedRays++;
+    return false;
+}
+
+/* -------------------------------------------------------------------------- */
+/* ----------  Closest hit of the ray, false when it leaves the scene ------- */
+bool hitRay(RayFrame& ray){
+    Object::IntersectionValues closest = closestHit(ray.p0, ray.E, 2.0 * EPSILON);
+
+    if (closest.ID_ == -1) {
+        return false; 
+    }
+
+    ray.ID = closest.ID_;
+    ray.P = closest.P;
+    ray.N = closest.N;
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+/* ----------  Phong lighting at the hit point, without shadows.     -------- */
+/* ----------  Returns the direction of the light                    -------- */
+vec4 shadeLocal(RayFrame& ray){
+    const Object::ShadingValues& shading = sceneObjects[ray.ID]->shadingValues;
+
+    // Ambiant Ia = Isa * Ka 
+    // ----------------------
+    double Isa = 1.0;
+    double ambiant = Isa * shading.Ka;
+
+    // Light Position 
+    // ---------------
+    vec4 L = lightPosition - ray.P;
+    L = normalize(L);
+    L.w = 0.0; 
+
+    // Diffuse
+    // --------
+    double Id = 1.0; 
+    double diffuse = Id * shading.Kd * (std::max)((double)Angel::dot(L, ray.N), 0.0); 
+
+    // Direction Vector : R , V 
+    // ---------------------------
+    // R : reflected direction 
+    // V : towards camera
+    vec4 R = -reflect(L, ray.N); // =  2.0 * Angel::dot(closest.N, L) * closest.N - L;
+    R = Angel::normalize(R);
+    R.w = 0.0; 
+
+    ray.V = -ray.E; // - direction du rayon 
+    ray.V.w = 0.0;
+
+    // Specular :  Is = Iss * Ks * dot(R, V)^n 
+    // ----------------------------------------
+    double Iss = 1.0;
+    double nr = shading.Kn; // exponent
+    double specular = Iss * shading.Ks * std::pow((std::max)((double)Angel::dot(ray.V, R), 0.0), nr);
+
+    // ===============
+    // Phong Equation
+    // ===============
+    ray.color = (ambiant * lightColor + diffuse * lightColor )* shading.color;
+    ray.color += specular * lightColor * shading.color;
+    equalizeColor(ray.color);
+
+    ray.attenuation = 1.0 / (double)(ray.depth + 1.0);
+    ray.refractColor = vec4(0.0, 0.0, 0.0, 0.0);
+    ray.refractScale = 1.0;
+    ray.specThroughput = ray.throughput * shading.Ks * ray.attenuation;
+    ray.specScale = 1.0;
+    return L;
+}
+
+/* -------------------------------------------------------------------------- */
+/* ----------  percentageShadowed of the light hidden from the hit   -------- */
+void applyShadow(RayFrame& ray, float percentageShadowed){
+    ray.color *= (1.0 - percentageShadowed);
+    ray.color.w = 1.0;
+}
+
+/* -------------------------------------------------------------------------- */
+/* ----------  Ray through the transparent object hit by ray, or    --------- */
+/* ----------  reflected inside when refraction is impossible       --------- */
+void refractedRay(RayFrame& ray, vec4& origin, vec4& dir){
+    // kr1 * sin(theta1) = kr2 * sin(theta2) 
+            
+    // Air coefficient of refraction 
+    double kr1 = 1.0; 
+    double kr2 = sceneObjects[ray.ID]->shadingValues.Kr; 
+            
+    vec4 vecInc = ray.E; 
+    vecInc = normalize(vecInc);
+    vecInc.w = 0.0;
+    // transmission : vector of refracted ray 
+    double cosTheta = Angel::dot(vecInc, normalize(ray.N)); // out 
+    vec4 normalPlanR = ray.N;
+    // outside towards air 
+    if (cosTheta > 0.0)
+    {
+        normalPlanR = -ray.N;
+        kr2 = kr1; 
+        kr1 = sceneObjects[ray.ID]->shadingValues.Kr;  
+    }
+
+    double nrf = kr1 / kr2; // n = n1 / n2 
+    double cosTheta2 = dot(vecInc, normalPlanR); 
+
+    double discriminant = 1.0 - (nrf * nrf) * (1.0 - cosTheta2*cosTheta2);
+
+    ray.internalReflection = discriminant < 0.0;
+    if (ray.internalReflection)
+    {
+        // refraction => reflection
+        origin = ray.P;
+        dir = -reflect(ray.V, ray.N);
+    }
+    else
+    {
+        // Refraction 
+        vec4 dirRefractTan = nrf * (vecInc - dot(vecInc, normalPlanR) * normalPlanR); // composante tangentielle 
+        vec4 dirRefractNor = - normalPlanR * std::sqrt(discriminant); // composante normale
+        dir = dirRefractTan + dirRefractNor;
+        dir = normalize(dir);
+        dir.w = 0.0;
+        origin = ray.P - dir * EPSILON;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* ----------  Color returned by the refracted child of ray          -------- */
+void receiveRefracted(RayFrame& ray, const color4& returned){
+    ray.refractColor = returned;
+    if (ray.internalReflection) {
+        ray.refractColor = ray.refractColor * lightColor;
+        clampColor(ray.refractColor);
+    }
+    else {
+        equalizeColor(ray.refractColor);
+    }
+    // after this clamp, combineRay still clamps the sum
+    ray.refractColor *= ray.refractScale;
+}
+
+/* -------------------------------------------------------------------------- */
+/* ----------  Color returned by the reflected child of ray          -------- */
+color4 receiveReflected(const RayFrame& ray, const color4& returned){
+    color4 specColor = returned;
+    equalizeColor(specColor);
+    specColor *= ray.specScale;
+    return specColor;
+}
+
+/* -------------------------------------------------------------------------- */
+/* ----------  Final color of ray once its children are back         -------- */
+color4 combineRay(const RayFrame& ray, const color4& specColor){
+    const Object::ShadingValues& shading = sceneObjects[ray.ID]->shadingValues;
+    color4 color = shading.Kt * ray.refractColor +
+                   shading.Ks * specColor * ray.attenuation +
+                   ray.color * (std::max)(0.0, (1.0 - 
+                                       shading.Ks * ray.attenuation -
+                                       shading.Kt));
+    equalizeColor(color);
+    return color;
+}
+
+/* -------------------------------------------------------------------------- */
+/* ----------  cast Ray = p0 + t*dir and intersect with the scene   --------- */
+/* ----------  Depth first like a recursion, but the pending rays   --------- */
+/* ----------  are kept on a fixed size stack : same image, no      --------- */
+/* ----------  stack growth with maxDepth                           --------- */
+vec4 castRay(vec4 p0, vec4 E, int depth, Sampler& sampler, double throughput){
+    const int maxDepth = (std::min)(renderSettings.maxDepth, maxRayDepth);
+
+    // depth, depth+1 ... maxDepth+1 : the last one is black and never waits.
+    // One stack per render thread, castRay doesn't call itself
+    static thread_local RayFrame stack[maxRayDepth + 2];
+    int top = 0;
+    stack[0].p0 = p0;
+    stack[0].E = E;
+    stack[0].depth = depth;
+    stack[0].throughput = throughput;
+    stack[0].stage = rayStart;
+
+    color4 returned = vec4(0.0, 0.0, 0.0, 0.0);
+
+    while (true) {
+        RayFrame& ray = stack[top];
+
+        if (ray.stage == rayStart) {
+            bool hit = false;
+            if (ray.depth <= maxDepth) {
+                if (ray.depth > 1) { tileRayCounts.secondaryRays++; }
+                hit = hitRay(ray);
+            }
+            if (!hit) {
+                returned = vec4(0.0, 0.0, 0.0, 0.0);
+                if (top == 0) { break; }
+                top--;
+                continue;
+            }
+
+            // Shadows :
+            // ----------
+            // Compute "hard" shadow if Nsamples = 1 
+            // Compute soft Shadows if Nsamples > 1 ( require at least 128 or 256 shadow rays) 
+            vec4 L = shadeLocal(ray);
+            applyShadow(ray, softShadow(ray.P + L * EPSILON, sampler, renderSettings.nshadowsample));
+
+            // Transparency  
+            // ------------
+            const Object::ShadingValues& shading = sceneObjects[ray.ID]->shadingValues;
+            ray.stage = raySpecular;
+            if (shading.Kt > 0.0 && shading.Kr > 0.0 &&
+                traceBranch(ray.throughput * shading.Kt, sampler, ray.refractScale))
+            {
+                RayFrame& child = stack[++top];
+                refractedRay(ray, child.p0, child.E);
+                child.depth = ray.depth + 1;
+                child.throughput = ray.throughput * shading.Kt;
+                child.stage = rayStart;
+                ray.stage = rayRefracted;
+                continue;
+            }
+        }
+        else if (ray.stage == rayRefracted) {
+            receiveRefracted(ray, returned);
+            ray.stage = raySpecular;
+        }
+
+        // Specular Contribution secondary rays 
+        //-----------------------------------------
+        color4 specColor = vec4(0.0, 0.0, 0.0, 0.0);
+        if (ray.stage == raySpecular) {
+            if (sceneObjects[ray.ID]->shadingValues.Ks > 0.0 && traceBranch(ray.specThroughput, sampler, ray.specScale))
+            {
+                RayFrame& child = stack[++top];
+                child.p0 = ray.P;
+                child.E = -reflect(ray.V, ray.N);
+                child.depth = ray.depth + 1;
+                child.throughput = ray.specThroughput;
+                child.stage = rayStart;
+                ray.stage = rayReflected;
+                continue;
+            }
+        }
+        else if (ray.stage == rayReflected) {
+            specColor = receiveReflected(ray, returned);
+        }
+
+        returned = combineRay(ray, specColor);
+
+        if (top == 0) { break; }
+        top--;
+    }
+
+    return returned;
+}
+
+
+/* -------------------------------------------------------------------------- */
+/* ------------  Anti-aliasing points of pixel idx : its own stream  --------- */
+/* ------------  after the streams of its samples                    --------- */
+SampleScramble pixelScramble(int idx){
+    Sampler sampler(idx, ~0u, renderSettings.seed);
+    return SampleScramble(renderSettings.pixelPattern, sampler);
+}
+
+/* -------------------------------------------------------------------------- */
+/* ------------  Add samples [k0,k1) of every pixel of one tile    --------- */
+/* ------------  to accum (rgb), tile covers [x0,x1) x [y0,y1),    --------- */
+/* ------------  accum starts at (x0,y0), rows of stride pixels    --------- */
+void renderTile(float *accum, int stride, int x0, int y0, int x1, int y1,
+                unsigned int k0, unsigned int k1, const Camera& camera){
+
+    for(int i=x0; i < x1; i++){
+
+        for(int j=y0; j < y1; j++){
+
+            int idx = j*camera.getWidth()+i;
+            SampleScramble scramble = pixelScramble(idx);
+
+            // anti aliasing 
+            double cx = 0.0;  
+            double cy = 0.0;  
+            double cz = 0.0;  
+            for (unsigned int k = k0; k < k1; k++) {
+                // the stream of a sample only depends on the pixel and k
+                Sampler sampler(idx, k, renderSettings.seed);
+                double xi, yj;
+                scramble.point(k, renderSettings.nraysample, sampler, xi, yj);
+                vec4 origin, dir;
+                camera.generateRay(i + xi, j + yj, origin, dir);
+                vec4 col = castRay(origin, dir, 1, sampler);
+                cx += col.x; 
+                cy += col.y; 
+                cz += col.z; 
+            }
+
+            float* pixel = accum + 3*((j-y0)*stride + (i-x0));
+            pixel[0] += cx;
+            pixel[1] += cy;
+            pixel[2] += cz;
+        }
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* ------------  Adaptive anti-aliasing of one tile : each pixel    --------- */
+/* ------------  samples until its mean luminance is known enough   --------- */
+void renderTileAdaptive(float *accum, unsigned int *counts, int stride, int x0, int y0, int x1, int y1,
+                        const Camera& camera){
+
+    const unsigned int nmax = renderSettings.nraysample;
+    // the variance needs two samples
+    const unsigned int nmin = (std::min)((std::max)(renderSettings.nminsample, 2u), nmax);
+    // the first rays cover a side x side grid of the pixel
+    const unsigned int side = (unsigned int)std::sqrt((double)nmin);
+
+    for(int i=x0; i < x1; i++){
+
+        for(int j=y0; j < y1; j++){
+
+            int idx = j*camera.getWidth()+i;
+            SampleScramble scramble = pixelScramble(idx);
+
+            double cx = 0.0;
+            double cy = 0.0;
+            double cz = 0.0;
+            double sumY = 0.0, sumY2 = 0.0;
+            unsigned int k = 0;
+            while (k < nmax) {
+                // same streams as renderTile, random positions stratified at first
+                Sampler sampler(idx, k, renderSettings.seed);
+                double xi, yj;
+                scramble.point(k, nmax, sampler, xi, yj);
+                if (renderSettings.pixelPattern == patternRandom && k < side*side) {
+                    xi = (k % side + xi) / side;
+                    yj = (k / side + yj) / side;
+                }
+                vec4 origin, dir;
+                camera.generateRay(i + xi, j + yj, origin, dir);
+                vec4 col = castRay(origin, dir, 1, sampler);
+                cx += col.x;
+                cy += col.y;
+                cz += col.z;
+                double Y = 0.2126*col.x + 0.7152*col.y + 0.0722*col.z;
+                sumY  += Y;
+                sumY2 += Y*Y;
+                k++;
+
+                if (k < nmin) { continue; }
+                double mean = sumY / k;
+                double variance = (std::max)(0.0, (sumY2 - k*mean*mean) / (k - 1));
+                // error of the mean at 95%, through the gamma 2 of resolveImage :
+                // d sqrt(m) = dm / (2 sqrt(m)), dark pixels bounded to 0.1 on screen
+                double error = 1.96 * std::sqrt(variance / k) / (2.0 * std::sqrt((std::max)(mean, 0.01)));
+                if (error <= renderSettings.noiseThreshold) { break; }
+            }
+
+            int p = (j-y0)*stride + (i-x0);
+            accum[3*p]   += cx;
+            accum[3*p+1] += cy;
+            accum[3*p+2] += cz;
+            counts[p] = k;
+        }
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* -----------   Tiles are pulled from a shared queue by every      --------- */
+/* -----------   OpenMP thread until the queue is empty             --------- */
+template < typename RenderTile >
+static bool renderTiles(const Camera& camera, const std::atomic < bool >* cancel, RenderCheckpoint* checkpoint,
+                        RenderTile renderOneTile){
+
+    const int width  = camera.getWidth();
+    const int height = camera.getHeight();
+    const int ntilesX = (width  + tileSize - 1) / tileSize;
+    const int ntilesY = (height + tileSize - 1) / tileSize;
+    const int ntiles  = ntilesX * ntilesY;
+    std::atomic < int > nextTile(0);
+
+    #pragma omp parallel
+    {
+        // each thread grabs the next free tile : fast threads simply take more tiles
+        for (int tile = nextTile++; tile < ntiles; tile = nextTile++) {
+            if (cancel != NULL && *cancel) { break; }
+            if (checkpoint != NULL && checkpoint->finished(tile)) { continue; }
+            int x0 = (tile % ntilesX) * tileSize;
+            int y0 = (tile / ntilesX) * tileSize;
+            renderOneTile(x0, y0, (std::min)(x0 + tileSize, width), (std::min)(y0 + tileSize, height));
+            addTileRayCounts();
+            if (checkpoint != NULL) { checkpoint->tileFinished(tile); }
+        }
+    }
+
+    return cancel == NULL || !*cancel;
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+bool renderSamples(const Camera& camera, unsigned int firstSample, unsigned int lastSample,
+                   float* accum, const std::atomic < bool >* cancel, RenderCheckpoint* checkpoint){
+
+    const int width = camera.getWidth();
+    return renderTiles(camera, cancel, checkpoint, [&](int x0, int y0, int x1, int y1){
+        float* tile = accum + 3*(y0*width + x0);
+        renderTile(tile, width, x0, y0, x1, y1, firstSample, lastSample, camera);
+    });
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+bool renderAdaptive(const Camera& camera, float* accum, unsigned int* counts,
+                    const std::atomic < bool >* cancel, RenderCheckpoint* checkpoint){
+
+    const int width = camera.getWidth();
+    return renderTiles(camera, cancel, checkpoint, [&](int x0, int y0, int x1, int y1){
+        const int first = y0*width + x0;
+        renderTileAdaptive(accum + 3*first, counts + first, width, x0, y0, x1, y1, camera);
+    });
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+void resolveImage(const float* accum, unsigned int nsamples, int npixels, unsigned char* rgba,
+                  const unsigned int* counts){
+    for (int idx = 0; idx < npixels; idx++) {
+        double n = (counts != NULL) ? counts[idx] : nsamples;
+        vec4 color = vec4(accum[3*idx], accum[3*idx+1], accum[3*idx+2], 0.0) / n;
+
+        // Gamma correction : 2 
+        // ---------------------
+        // std::pow(color, 1. / gamma  ) 
+        color.x = std::sqrt(color.x); 
+        color.y = std::sqrt(color.y); 
+        color.z = std::sqrt(color.z);
+        color.w = 1.0; 
+        clampColor(color);
+
+        rgba[4*idx]   = color.x*255;
+        rgba[4*idx+1] = color.y*255;
+        rgba[4*idx+2] = color.z*255;
+        rgba[4*idx+3] = color.w*255;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+void meanImage(const float* accum, unsigned int nsamples, int npixels, float* rgb,
+               const unsigned int* counts){
+    for (int idx = 0; idx < npixels; idx++) {
+        float n = (float)((counts != NULL) ? counts[idx] : nsamples);
+        rgb[3*idx]   = accum[3*idx]   / n;
+        rgb[3*idx+1] = accum[3*idx+1] / n;
+        rgb[3*idx+2] = accum[3*idx+2] / n;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* ------------  Portable float map : text header, then raw little  --------- */
+/* ------------  endian floats, bottom row first                    --------- */
+static bool littleEndian(){
+    const unsigned int one = 1;
+    return *(const unsigned char*)&one == 1;
+}
+
+static void swapFloats(float* values, size_t n){
+    for (size_t k = 0; k < n; k++) {
+        unsigned char* b = (unsigned char*)&values[k];
+        std::swap(b[0], b[3]);
+        std::swap(b[1], b[2]);
+    }
+}
+
+bool write_pfm(const char* filename, const float* rgb, int width, int height){
+    FILE * file = fopen(filename, "wb");
+    if (file == NULL) {
+        std::cerr << "can't open " << filename << " for writing." << std::endl;
+        return false;
+    }
+
+    // a negative scale : little endian
+    bool written = fprintf(file, "PF\n%d %d\n-1.0\n", width, height) > 0;
+    std::vector < float > row(3 * width);
+    for (int j = height - 1; written && j >= 0; j--) {
+        std::copy(rgb + 3*j*width, rgb + 3*(j+1)*width, row.begin());
+        if (!littleEndian()) { swapFloats(&row[0], row.size()); }
+        written = fwrite(&row[0], sizeof(float), row.size(), file) == row.size();
+    }
+    written = (fclose(file) == 0) && written;
+
+    if (written) { std::cerr << "finished writing " << filename << "." << std::endl; }
+    else         { std::cerr << "write to " << filename << " failed." << std::endl; }
+    return written;
+}
+
+bool read_pfm(const char* filename, std::vector < float >& rgb, int& width, int& height){
+    FILE * file = fopen(filename, "rb");
+    if (file == NULL) { return false; }
+
+    char type[3] = {0, 0, 0};
+    double scale = 0.0;
+    // a single white space after the scale, the floats start right after
+    bool valid = fscanf(file, "%2s %d %d %lf", type, &width, &height, &scale) == 4
+              && strcmp(type, "PF") == 0 && width > 0 && height > 0 && scale != 0.0
+              && fgetc(file) != EOF;
+
+    if (valid) {
+        rgb.resize(3 * (size_t)width * height);
+        for (int j = height - 1; valid && j >= 0; j--) {
+            float* row = &rgb[3 * (size_t)j * width];
+            valid = fread(row, sizeof(float), 3 * width, file) == (size_t)(3 * width);
+            if ((scale < 0.0) != littleEndian()) { swapFloats(row, 3 * width); }
+        }
+    }
+    fclose(file);
+    return valid;
+}
+
+/* -------------------------------------------------------------------------- */
+/* ------------  Image of accum as png (gamma 2, 8 bits) or, for a  --------- */
+/* ------------  .pfm filename, linear floats                       --------- */
+bool writeRender(const char* filename, const float* accum, unsigned int nsamples,
+                 int width, int height, const unsigned int* counts){
+    const int npixels = width * height;
+    size_t length = strlen(filename);
+    if (length >= 4 && strcmp(filename + length - 4, ".pfm") == 0) {
+        std::vector < float > rgb(3 * npixels);
+        meanImage(accum, nsamples, npixels, &rgb[0], counts);
+        return write_pfm(filename, &rgb[0], width, height);
+    }
+
+    std::vector < unsigned char > rgba(4 * npixels);
+    resolveImage(accum, nsamples, npixels, &rgba[0], counts);
+    return write_image(filename, &rgba[0], width, height, 4);
+}
+
+/* -------------------------------------------------------------------------- */
+/* ------------  Samples per pixel, blue for a single ray to red     -------- */
+/* ------------  for nmax rays                                       -------- */
+void heatmapImage(const unsigned int* counts, unsigned int nmax, int npixels, unsigned char* rgba){
+    for (int idx = 0; idx < npixels; idx++) {
+        double t = (nmax > 1) ? (counts[idx] - 1.0) / (nmax - 1.0) : 1.0;
+        // blue -> green -> red
+        double r = (std::max)(0.0, 2.0*t - 1.0);
+        double b = (std::max)(0.0, 1.0 - 2.0*t);
+        double g = 1.0 - r - b;
+
+        rgba[4*idx]   = r*255;
+        rgba[4*idx+1] = g*255;
+        rgba[4*idx+2] = b*255;
+        rgba[4*idx+3] = 255;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* ------------  Statistics of a finished render, rays : every      --------- */
+/* ------------  anti-aliasing ray traced                           --------- */
+static void reportRender(const Camera& camera, double seconds, long long rays){
+    const unsigned int nraysample = renderSettings.nraysample;
+    const long long npixels = (long long)camera.getWidth() * camera.getHeight();
+    std::cerr << "rendered " << camera.getWidth() << "x" << camera.getHeight() << " on " << omp_get_max_threads()
+              << " threads in " << seconds << "s (" << SphereSet::kernelName() << " sphere kernel)." << std::endl;
+    if (renderSettings.nminsample > 0) {
+        std::cerr << "adaptive anti-aliasing : " << (double)rays / npixels << " rays per pixel (from "
+                  << (std::min)((std::max)(renderSettings.nminsample, 2u), nraysample) << " to " << nraysample
+                  << ", noise " << renderSettings.noiseThreshold << ")." << std::endl;
+    }
+    if (shadowHitCount > 0) {
+        std::cerr << "shadow rays per hit : " << (double)shadowRayCount / shadowHitCount
+                  << " (budget " << renderSettings.nshadowsample << ")." << std::endl;
+    }
+    std::cerr << "secondary rays : " << secondaryRayCount << " traced, " << prunedRayCount
+              << (renderSettings.roulette ? " stopped by russian roulette" : " cut")
+              << " below throughput " << renderSettings.minThroughput << "." << std::endl;
+}
+
+/* -------------------------------------------------------------------------- */
+/* ------------  Ray trace our scene.  Output color to image and    --------- */
+/* -----------   save to disk                                       --------- */
+bool rayTrace(const Camera& camera, const char* filename, const char* heatmap,
+              const CheckpointSettings* checkpointSettings){
+
+    const unsigned int nraysample = renderSettings.nraysample; 
+    const bool adaptive = renderSettings.nminsample > 0;
+    const int width  = camera.getWidth();
+    const int height = camera.getHeight();
+    std::vector < float > accum(3*width*height, 0.0f);
+    std::vector < unsigned int > counts(width*height, nraysample);
+
+    shadowRayCount = 0;
+    shadowHitCount = 0;
+    secondaryRayCount = 0;
+    prunedRayCount = 0;
+
+    std::unique_ptr < RenderCheckpoint > checkpoint;
+    if (checkpointSettings != NULL) {
+        checkpoint.reset(new RenderCheckpoint(*checkpointSettings, camera, tileSize,
+                                              &accum[0], adaptive ? &counts[0] : NULL));
+        if (checkpointSettings->resume && checkpoint->load()) {
+            std::cerr << "resumed " << checkpointSettings->path << " : " << checkpoint->finishedTiles()
+                      << " tiles already rendered." << std::endl;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    if (adaptive) {
+        renderAdaptive(camera, &accum[0], &counts[0], NULL, checkpoint.get());
+    }
+    else {
+        renderSamples(camera, 0, nraysample, &accum[0], NULL, checkpoint.get());
+    }
+
+    long long rays = 0;
+    for (unsigned int n : counts) { rays += n; }
+    reportRender(camera, std::chrono::duration < double >(std::chrono::steady_clock::now() - start).count(), rays);
+
+    bool written = writeRender(filename, &accum[0], nraysample, width, height, adaptive ? &counts[0] : NULL);
+    // the image holds everything the checkpoint had
+    if (written && checkpoint) { remove(checkpointSettings->path.c_str()); }
+
+    // after the image : a missing heatmap doesn't lose the render
+    if (heatmap != NULL) {
+        std::vector < unsigned char > buffer(4*width*height);
+        heatmapImage(&counts[0], nraysample, width*height, &buffer[0]);
+        if (!write_image(heatmap, &buffer[0], width, height, 4)) {
+            std::cerr << "warning : the heatmap " << heatmap << " is not written." << std::endl;
+        }
+    }
+    return written;
+}
+
+/* -------------------------------------------------------------------------- */
+/* ------------  Same render as rayTrace, each tile in its own      --------- */
+/* ------------  buffer handed to sink once finished                --------- */
+bool rayTraceStreamed(const Camera& camera, RenderSink& sink){
+
+    const unsigned int nraysample = renderSettings.nraysample;
+    const bool adaptive = renderSettings.nminsample > 0;
+
+    shadowRayCount = 0;
+    shadowHitCount = 0;
+    secondaryRayCount = 0;
+    prunedRayCount = 0;
+
+    if (!sink.begin(camera.getWidth(), camera.getHeight(), tileSize)) { return false; }
+
+    // a tile the sink refuses stops the render
+    std::atomic < bool > failed(false);
+    std::atomic < long long > rays(0);
+    auto start = std::chrono::steady_clock::now();
+
+    renderTiles(camera, &failed, NULL, [&](int x0, int y0, int x1, int y1){
+        const int tileWidth = x1 - x0;
+        const int npixels = tileWidth * (y1 - y0);
+        std::vector < float > accum(3*npixels, 0.0f);
+        std::vector < unsigned int > counts(npixels, nraysample);
+        if (adaptive) {
+            renderTileAdaptive(&accum[0], &counts[0], tileWidth, x0, y0, x1, y1, camera);
+        }
+        else {
+            renderTile(&accum[0], tileWidth, x0, y0, x1, y1, 0, nraysample, camera);
+        }
+        long long tileRays = 0;
+        for (unsigned int n : counts) { tileRays += n; }
+        rays += tileRays;
+        if (!sink.tile(x0, y0, x1, y1, &accum[0], &counts[0])) { failed = true; }
+    });
+
+    reportRender(camera, std::chrono::duration < double >(std::chrono::steady_clock::now() - start).count(), rays);
+    return sink.end(!failed);
+}
@@ -0,0 +1,177 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  --- raytrace.h ---
+//
+//  Scenes and CPU ray tracer shared by the GLFW viewer (main.cpp) and the
+//  headless batch renderer (headless.cpp). Nothing here needs a GL context.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef __RAYTRACE_H__
+#define __RAYTRACE_H__
+
+#include "common.h"
+#include <atomic>
+
+typedef vec4  color4;
+typedef vec4  point4;
+
+//Scene variables
+enum{_SPHERE, _SQUARE, _BOX, _BOXEASYSPHERE};
+extern std::vector < Object * > sceneObjects;
+extern BVH sceneBVH; // over sceneObjects, rebuilt by buildSceneBVH() when the scene changes
+extern SphereSet sceneSpheres; // spheres of sceneObjects in sceneBVH.primIndices order
+extern point4 lightPosition;
+extern color4 lightColor;
+extern point4 cameraPosition;
+
+//Ray tracer parameters
+typedef struct{
+    unsigned int nraysample; // anti-aliasing rays per pixel
+    int nshadowsample;       // shadow rays per hit point, 1 : hard shadows
+    int nshadowbatch;        // first stratified shadow rays, the rest only in the penumbra
+    int maxDepth;            // recursion depth
+    unsigned int seed;       // random streams, same seed : same image
+    double minThroughput;    // secondary rays weighing less are pruned, 0 : never
+    bool roulette;           // pruned by russian roulette instead of cut
+    unsigned int nminsample; // adaptive anti-aliasing : first stratified rays of every pixel, 0 : always nraysample
+    double noiseThreshold;   // adaptive : a pixel is done once its 95% error on screen is below
+    SamplePattern pixelPattern; // positions of the anti-aliasing rays in a pixel
+    SamplePattern lightPattern; // positions of the shadow rays in a light cell
+} RenderSettings;
+
+extern RenderSettings renderSettings;
+
+// castRay keeps its pending rays on a fixed stack : deeper settings are clamped
+constexpr int maxRayDepth = 64;
+
+// transparent material doesn't cast shadow 
+inline bool transparentToShadows(const Object* object){ return object->shadingValues.Kt > 0.8; }
+
+/* -- scenes.cpp -- */
+void initUnitSphere();
+void initUnitSquare();
+void initCornellBox();
+void initCornellBox2();
+bool initScene(int scene);                      // false if scene is unknown
+mat4 sceneProjection(int scene, GLfloat aspect);
+void buildSceneBVH();
+bool addObjModel(const char* path, const vec3& position, float size);
+
+/* -- raytrace.cpp -- */
+Object::IntersectionValues closestHit(const vec4& p0, const vec4& dir, double tmin, bool skipTransparent=false);
+bool sceneOccluded(const vec4& p0, const vec4& dir, double tmin, double tmax); // any hit, transparent objects skipped
+void castRayDebug(vec4 p0, vec4 dir);
+// throughput : weight of the returned color in the pixel
+vec4 castRay(vec4 p0, vec4 E, int depth, Sampler& sampler, double throughput=1.0);
+
+/* -- steps of castRay -- */
+
+// One ray of the ray tree. A ray waits on its refracted then its reflected
+// child, the colors are combined once both are back.
+enum RayStage{ rayStart, rayRefracted, raySpecular, rayReflected };
+
+struct RayFrame{
+    vec4 p0, E;
+    int depth;
+    double throughput;
+    RayStage stage;
+
+    int ID;                  // closest object
+    vec4 P, N, V;
+    color4 color;            // phong and shadows at P
+    double attenuation;
+
+    bool internalReflection; // refraction impossible : the child is reflected
+    double refractScale, specScale, specThroughput;
+    color4 refractColor;
+};
+
+bool hitRay(RayFrame& ray);                          // closest hit, false : missed the scene
+vec4 shadeLocal(RayFrame& ray);                      // phong without shadows, returns L
+void applyShadow(RayFrame& ray, float percentageShadowed);
+bool traceBranch(double throughput, Sampler& sampler, double& scale); // pruning of a child ray
+void refractedRay(RayFrame& ray, vec4& origin, vec4& dir);
+void receiveRefracted(RayFrame& ray, const color4& returned);
+color4 receiveReflected(const RayFrame& ray, const color4& returned);
+color4 combineRay(const RayFrame& ray, const color4& specColor);
+
+// area light : grid of cells over the light, point k of the n of a cell
+// (scramble : renderSettings.lightPattern of the hit point) and cells
+// crossed by a shadow edge
+constexpr int maxShadowGridSide = 16;
+int shadowGridSide(int Nsamples);
+vec4 lightSample(int c, int side, unsigned int k, unsigned int n, const SampleScramble& scramble, Sampler& sampler);
+bool penumbraCell(const bool* inShadow, int c, int side);
+bool shadowFeeler(const vec4& p0, const vec4& lightp);
+
+// rays statistics of the current render
+extern std::atomic < long long > shadowRayCount, shadowHitCount;
+extern std::atomic < long long > secondaryRayCount, prunedRayCount;
+
+// renderSettings.pixelPattern of pixel idx, same for every sample of the pixel
+SampleScramble pixelScramble(int idx);
+
+// Periodic saves of the finished tiles of rayTrace (checkpoint.h)
+// Shortest interval between two checkpoints, in seconds
+constexpr double minCheckpointInterval = 1.0;
+
+struct CheckpointSettings{
+    std::string path;  // checkpoint file, removed once the image is written
+    double interval;   // seconds between two saves, at least minCheckpointInterval
+    bool resume;       // only renders the tiles missing from path
+    std::string job;   // scene and models : a checkpoint of another job is ignored
+};
+class RenderCheckpoint;
+
+// Render the whole image seen by camera with renderSettings and write it as png,
+// heatmap : optional png of the rays spent per pixel (blue few, red nraysample)
+bool rayTrace(const Camera& camera, const char* filename, const char* heatmap=NULL,
+              const CheckpointSettings* checkpoint=NULL);
+
+// Same image as rayTrace without a full frame buffer : every tile is rendered
+// in its own buffer, handed to sink (rendersink.h) and freed. No checkpoint
+// nor heatmap.
+class RenderSink;
+bool rayTraceStreamed(const Camera& camera, RenderSink& sink);
+
+// Adds anti-aliasing samples [firstSample, lastSample) of every pixel to accum
+// (3 floats per pixel). Stops early and returns false when *cancel is set.
+// Tiles finished in checkpoint are skipped, the others reported to it.
+bool renderSamples(const Camera& camera, unsigned int firstSample, unsigned int lastSample,
+                   float* accum, const std::atomic < bool >* cancel=NULL,
+                   RenderCheckpoint* checkpoint=NULL);
+
+// Adaptive anti-aliasing : every pixel starts with nminsample stratified rays
+// and stops between nminsample and nraysample once its noise is low enough.
+// Sums go to accum and the rays of every pixel to counts.
+bool renderAdaptive(const Camera& camera, float* accum, unsigned int* counts,
+                    const std::atomic < bool >* cancel=NULL, RenderCheckpoint* checkpoint=NULL);
+
+// accum / nsamples with gamma 2 to RGBA 8 bits, counts : samples of every
+// pixel instead of nsamples
+void resolveImage(const float* accum, unsigned int nsamples, int npixels, unsigned char* rgba,
+                  const unsigned int* counts=NULL);
+
+// accum / nsamples, linear
+void meanImage(const float* accum, unsigned int nsamples, int npixels, float* rgb,
+               const unsigned int* counts=NULL);
+
+// resolved image in the format of the filename : .pfm linear floats (no
+// gamma, no clamping, lossless), png otherwise
+bool writeRender(const char* filename, const float* accum, unsigned int nsamples,
+                 int width, int height, const unsigned int* counts=NULL);
+
+// mode : png_enc_classic for the original random filters and short matches
+// threads : bands of rows compressed in parallel (heuristic mode), 0 for
+// all the OpenMP threads, 1 for a single deflate stream
+bool write_image(const char* filename, const unsigned char *Src,
+                 int Width, int Height, int channels,
+                 cmps3120::png_enc_mode mode=cmps3120::png_enc_heuristic,
+                 int threads=0);
+
+// Portable float map, 3 floats per pixel, top row first in rgb
+bool write_pfm(const char* filename, const float* rgb, int width, int height);
+bool read_pfm(const char* filename, std::vector < float >& rgb, int& width, int& height);
+
+#endif // __RAYTRACE_H__
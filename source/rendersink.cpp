@@ -0,0 +1,304 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  --- rendersink.cpp ---
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "rendersink.h"
+
+//Rows of tiles finished ahead of the png encoder before the render threads wait
+constexpr int maxReadyBands = 4;
+
+static bool hasExtension(const std::string& filename, const char* extension){
+    const size_t n = strlen(extension);
+    return filename.size() >= n && filename.compare(filename.size() - n, n, extension) == 0;
+}
+
+/* -------------------------------------------------------------------------- */
+/* ------  Rows of the sink for the encoder : a single thread copies    ----- */
+/* ------  each row right away, so the sink may free it at the next one ----- */
+class PNGStreamReceptor : public cmps3120::png_receptor
+{
+private:
+    PNGStreamSink& sink;
+
+public:
+    PNGStreamReceptor(PNGStreamSink& sink) : sink(sink) {}
+    cmps3120::png_header get_header(){
+        cmps3120::png_header header;
+        header.width = sink.getWidth();
+        header.height = sink.getHeight();
+        header.bit_depth = 8;
+        header.color_type = cmps3120::PNG_RGBA;
+        return header;
+    }
+    const unsigned char* get_row(unsigned int y){
+        return sink.row(y);
+    }
+};
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+PNGStreamSink::PNGStreamSink(const std::string& filename)
+    : filename(filename), width(0), height(0), tileSize(1), ntilesX(0),
+      encoded(0), aborted(false), written(false){
+}
+
+PNGStreamSink::~PNGStreamSink(){
+    if (encoder.joinable()) { end(false); }
+}
+
+bool PNGStreamSink::begin(int width, int height, int tileSize){
+    this->width = width;
+    this->height = height;
+    this->tileSize = tileSize;
+    ntilesX = (width + tileSize - 1) / tileSize;
+    blank.assign(4 * (size_t)width, 0);
+
+    // the encoder opens the file itself : fail now rather than mid render
+    FILE * file = fopen(filename.c_str(), "wb");
+    if (file == NULL) {
+        std::cerr << "can't open " << filename << " for writing." << std::endl;
+        return false;
+    }
+    fclose(file);
+
+    encoder = std::thread(&PNGStreamSink::encode, this);
+    return true;
+}
+
+void PNGStreamSink::encode(){
+    cmps3120::png_encoder encoder;
+    PNGStreamReceptor receptor(*this);
+    encoder.set_mode(cmps3120::png_enc_heuristic);
+    // a single deflate stream : parallel bands would ask for every row first
+    // and keep them until the end (png_receptor::get_row)
+    encoder.set_threads(1);
+    encoder.set_receptor(&receptor);
+    written = encoder.write_file(filename.c_str()) == cmps3120::PNG_DONE;
+
+    // nobody reads the rows anymore : release the render threads
+    if (!written) {
+        std::lock_guard < std::mutex > lock(mutex);
+        aborted = true;
+        changed.notify_all();
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+bool PNGStreamSink::finished(int band) const{
+    std::map < int, Band >::const_iterator found = bands.find(band);
+    return found != bands.end() && found->second.tiles == ntilesX;
+}
+
+// finished rows of tiles the encoder can go through without waiting
+int PNGStreamSink::readyBands() const{
+    int ready = 0;
+    while (finished(encoded + ready)) { ready++; }
+    return ready;
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+bool PNGStreamSink::tile(int x0, int y0, int x1, int y1, const float* accum, const unsigned int* counts){
+    const int tileWidth = x1 - x0;
+    std::vector < unsigned char > rgba(4 * tileWidth * (y1 - y0));
+    resolveImage(accum, 0, tileWidth * (y1 - y0), &rgba[0], counts);
+
+    const int band = y0 / tileSize;
+    std::unique_lock < std::mutex > lock(mutex);
+    Band& rows = bands[band];
+    if (rows.rgba.empty()) {
+        const int nrows = (std::min)(tileSize, height - band * tileSize);
+        rows.rgba.assign(4 * (size_t)width * nrows, 0);
+        rows.tiles = 0;
+    }
+    for (int j = y0; j < y1; j++) {
+        std::copy(&rgba[4 * (j - y0) * tileWidth], &rgba[4 * (j - y0 + 1) * tileWidth],
+                  &rows.rgba[4 * ((size_t)(j - band * tileSize) * width + x0)]);
+    }
+    if (++rows.tiles == ntilesX) { changed.notify_all(); }
+
+    // the encoder is behind : stop rendering instead of piling up rows
+    changed.wait(lock, [this]{ return aborted || readyBands() <= maxReadyBands; });
+    return !aborted;
+}
+
+/* -------------------------------------------------------------------------- */
+/* ------  Rows are asked in order by a single stream encoder, which    ----- */
+/* ------  copies them : the previous row of tiles can be freed         ----- */
+const unsigned char* PNGStreamSink::row(unsigned int y){
+    const int band = y / tileSize;
+    std::unique_lock < std::mutex > lock(mutex);
+    if (band != encoded) {
+        bands.erase(encoded);
+        encoded = band;
+        changed.notify_all();
+    }
+    changed.wait(lock, [this, band]{ return aborted || finished(band); });
+    if (aborted) { return &blank[0]; }
+    return &bands[band].rgba[4 * (size_t)(y - band * tileSize) * width];
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+bool PNGStreamSink::end(bool complete){
+    if (!complete) {
+        std::lock_guard < std::mutex > lock(mutex);
+        aborted = true;
+        changed.notify_all();
+    }
+    if (encoder.joinable()) { encoder.join(); }
+    bands.clear();
+
+    if (written && complete) {
+        std::cerr << "finished writing " << filename << "." << std::endl;
+        return true;
+    }
+    std::cerr << "write to " << filename << " failed." << std::endl;
+    remove(filename.c_str());
+    return false;
+}
+
+/* -------------------------------------------------------------------------- */
+/* ------  .rtt file : header then one slot of tileSize x tileSize      ----- */
+/* ------  pixels per tile. complete is only set by end().              ----- */
+struct TiledRawHeader{
+    char magic[4];
+    unsigned int version; // reads as another number with the other byte order
+    int width, height, tileSize;
+    int complete;
+};
+
+static const char tiledRawMagic[4] = { 'R', 'T', 'T', 'L' };
+static const unsigned int tiledRawVersion = 1;
+
+static bool seekFile(FILE* file, unsigned long long offset){
+#if defined(_WIN32)
+    return _fseeki64(file, (__int64)offset, SEEK_SET) == 0;
+#else
+    return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+static unsigned long long tileOffset(int tile, int tileSize){
+    return sizeof(TiledRawHeader) + (unsigned long long)tile * tileSize * tileSize * 3 * sizeof(float);
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+TiledRawSink::TiledRawSink(const std::string& filename)
+    : filename(filename), width(0), height(0), tileSize(1), ntilesX(0), file(NULL), failed(false){
+}
+
+TiledRawSink::~TiledRawSink(){
+    if (file != NULL) { end(false); }
+}
+
+bool TiledRawSink::begin(int width, int height, int tileSize){
+    this->width = width;
+    this->height = height;
+    this->tileSize = tileSize;
+    ntilesX = (width + tileSize - 1) / tileSize;
+
+    file = fopen(filename.c_str(), "wb");
+    if (file == NULL) {
+        std::cerr << "can't open " << filename << " for writing." << std::endl;
+        return false;
+    }
+    TiledRawHeader header;
+    memcpy(header.magic, tiledRawMagic, 4);
+    header.version = tiledRawVersion;
+    header.width = width;
+    header.height = height;
+    header.tileSize = tileSize;
+    header.complete = 0;
+    failed = fwrite(&header, sizeof(header), 1, file) != 1;
+    return !failed;
+}
+
+bool TiledRawSink::tile(int x0, int y0, int x1, int y1, const float* accum, const unsigned int* counts){
+    const int npixels = (x1 - x0) * (y1 - y0);
+    std::vector < float > rgb(3 * npixels);
+    meanImage(accum, 0, npixels, &rgb[0], counts);
+
+    const int tile = (y0 / tileSize) * ntilesX + x0 / tileSize;
+    std::lock_guard < std::mutex > lock(mutex);
+    failed = failed || !seekFile(file, tileOffset(tile, tileSize))
+          || fwrite(&rgb[0], sizeof(float), rgb.size(), file) != rgb.size();
+    return !failed;
+}
+
+bool TiledRawSink::end(bool complete){
+    if (file == NULL) { return false; }
+    int flag = (complete && !failed) ? 1 : 0;
+    bool written = seekFile(file, offsetof(TiledRawHeader, complete))
+                && fwrite(&flag, sizeof(flag), 1, file) == 1;
+    written = (fclose(file) == 0) && written && flag;
+    file = NULL;
+
+    if (written) { std::cerr << "finished writing " << filename << "." << std::endl; }
+    else         { std::cerr << "write to " << filename << " failed." << std::endl; }
+    return written;
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+std::unique_ptr < RenderSink > createRenderSink(const std::string& filename){
+    if (hasExtension(filename, ".rtt")) { return std::unique_ptr < RenderSink >(new TiledRawSink(filename)); }
+    if (hasExtension(filename, ".pfm")) { return std::unique_ptr < RenderSink >(); }
+    return std::unique_ptr < RenderSink >(new PNGStreamSink(filename));
+}
+
+/* -------------------------------------------------------------------------- */
+/* ------  The tiles in row major order, every pixel a single sample   ------ */
+/* ------  of its mean color : resolved like a .pfm                     ------ */
+bool convertTiledRaw(const char* input, const char* output){
+    FILE * file = fopen(input, "rb");
+    if (file == NULL) { return false; }
+
+    TiledRawHeader header;
+    bool valid = fread(&header, sizeof(header), 1, file) == 1
+              && memcmp(header.magic, tiledRawMagic, 4) == 0
+              && header.version == tiledRawVersion
+              && header.width > 0 && header.height > 0 && header.tileSize > 0;
+    if (valid && !header.complete) {
+        std::cerr << input << " is an unfinished render." << std::endl;
+        valid = false;
+    }
+    if (!valid) {
+        fclose(file);
+        return false;
+    }
+
+    const int width = header.width, height = header.height, tileSize = header.tileSize;
+    const int ntilesX = (width + tileSize - 1) / tileSize;
+    const int ntiles = ntilesX * ((height + tileSize - 1) / tileSize);
+    const bool pfm = hasExtension(output, ".pfm");
+    std::vector < float > image(pfm ? 3 * (size_t)width * height : 0);
+    std::vector < float > rgb(3 * tileSize * tileSize);
+    std::vector < unsigned int > ones(tileSize * tileSize, 1);
+    PNGStreamSink sink(output);
+    if (!pfm) { valid = sink.begin(width, height, tileSize); }
+
+    for (int tile = 0; valid && tile < ntiles; tile++) {
+        const int x0 = (tile % ntilesX) * tileSize, y0 = (tile / ntilesX) * tileSize;
+        const int x1 = (std::min)(x0 + tileSize, width), y1 = (std::min)(y0 + tileSize, height);
+        const size_t n = 3 * (size_t)(x1 - x0) * (y1 - y0);
+        valid = seekFile(file, tileOffset(tile, tileSize)) && fread(&rgb[0], sizeof(float), n, file) == n;
+        if (valid && pfm) {
+            for (int j = y0; j < y1; j++) {
+                std::copy(&rgb[3 * (j - y0) * (x1 - x0)], &rgb[3 * (j - y0 + 1) * (x1 - x0)],
+                          &image[3 * ((size_t)j * width + x0)]);
+            }
+        }
+        else if (valid) {
+            valid = sink.tile(x0, y0, x1, y1, &rgb[0], &ones[0]);
+        }
+    }
+    fclose(file);
+
+    if (pfm) { return valid && write_pfm(output, &image[0], width, height); }
+    return sink.end(valid) && valid;
+}
@@ -0,0 +1,108 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  --- rendersink.h ---
+//
+//  Outputs of rayTraceStreamed : the finished tiles go to a sink instead of
+//  a full frame buffer, so a poster sized render only holds the tiles in
+//  flight. PNGStreamSink puts them back in order, a row of tiles at a time,
+//  for a png encoder running beside the render. TiledRawSink writes them
+//  as they come to a tiled file of linear floats (.rtt), converted to png
+//  or pfm afterwards by convertTiledRaw.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef __RENDERSINK_H__
+#define __RENDERSINK_H__
+
+#include "raytrace.h"
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <map>
+#include <memory>
+
+class RenderSink{
+public:
+    virtual ~RenderSink() {}
+
+    // Before the first tile, false if the output can't be created
+    virtual bool begin(int width, int height, int tileSize) = 0;
+
+    // A finished tile [x0,x1) x [y0,y1) : sums of the samples (3 floats per
+    // pixel) and samples of every pixel, rows of x1-x0 pixels. Called by the
+    // render threads in any order, the buffers are freed on return.
+    virtual bool tile(int x0, int y0, int x1, int y1, const float* accum, const unsigned int* counts) = 0;
+
+    // After the last tile, complete is false if some tiles are missing.
+    // False if the output is not written.
+    virtual bool end(bool complete) = 0;
+};
+
+// png_enc_heuristic png written by its own thread while the image renders.
+// The rows of tiles are resolved (gamma 2, 8 bits) and freed once encoded.
+class PNGStreamSink : public RenderSink{
+public:
+    PNGStreamSink(const std::string& filename);
+    ~PNGStreamSink();
+
+    bool begin(int width, int height, int tileSize);
+    bool tile(int x0, int y0, int x1, int y1, const float* accum, const unsigned int* counts);
+    bool end(bool complete);
+
+    // RGBA of row y for the encoder, waits until its row of tiles is finished
+    const unsigned char* row(unsigned int y);
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+private:
+    struct Band{
+        std::vector < unsigned char > rgba;
+        int tiles; // finished tiles of the row
+    };
+
+    void encode();
+    bool finished(int band) const;
+    int readyBands() const;
+
+    std::string filename;
+    int width, height, tileSize, ntilesX;
+
+    std::mutex mutex; // bands, encoded and aborted
+    std::condition_variable changed;
+    std::map < int, Band > bands; // rows of tiles being rendered or waiting for the encoder
+    int encoded;                  // row of tiles read by the encoder
+    bool aborted;
+    std::vector < unsigned char > blank;
+
+    std::thread encoder;
+    bool written;
+};
+
+// Tiles in the order they finish at fixed places of a .rtt file : header,
+// then for each tile (row major) tileSize x tileSize mean colors, 3 native
+// floats per pixel, rows of the tile's width
+class TiledRawSink : public RenderSink{
+public:
+    TiledRawSink(const std::string& filename);
+    ~TiledRawSink();
+
+    bool begin(int width, int height, int tileSize);
+    bool tile(int x0, int y0, int x1, int y1, const float* accum, const unsigned int* counts);
+    bool end(bool complete);
+
+private:
+    std::string filename;
+    int width, height, tileSize, ntilesX;
+    std::mutex mutex; // file
+    FILE* file;
+    bool failed;
+};
+
+// TiledRawSink for a .rtt filename, PNGStreamSink otherwise. NULL for .pfm :
+// written bottom row first, it can't be streamed.
+std::unique_ptr < RenderSink > createRenderSink(const std::string& filename);
+
+// .rtt file to png (streamed, a row of tiles in memory) or pfm
+bool convertTiledRaw(const char* input, const char* output);
+
+#endif // __RENDERSINK_H__
@@ -0,0 +1,644 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  --- scenes.cpp ---
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "raytrace.h"
+
+/* -------------------------------------------------------------------------- */
+/* ---------  (Re)build the BVH after sceneObjects changed  ----------------- */
+void buildSceneBVH(){
+    std::vector < vec3 > bmin(sceneObjects.size()), bmax(sceneObjects.size());
+    for (unsigned int i = 0; i < sceneObjects.size(); i++) {
+        sceneObjects[i]->getBounds(bmin[i], bmax[i]);
+    }
+    // a leaf fits in one SIMD pass over its spheres
+    sceneBVH.build(bmin, bmax, SphereSet::laneCount);
+
+    sceneSpheres.reset(sceneBVH.primIndices.size());
+    for (unsigned int k = 0; k < sceneBVH.primIndices.size(); k++) {
+        Object* object = sceneObjects[sceneBVH.primIndices[k]];
+        Sphere* sphere = dynamic_cast< Sphere* >(object);
+        if (sphere != NULL) {
+            sceneSpheres.setSphere(k, sphere->getCenter(), sphere->getRadius());
+        }
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+void initCornellBox(){
+    cameraPosition = point4( 0.0, 0.0, 6.0, 1.0 );
+    lightPosition = point4( 0.0, 1.5, 0.0, 1.0 );
+    lightColor = color4( 1.0, 1.0, 1.0, 1.0);
+
+    sceneObjects.clear();
+
+    { //Back Wall
+        sceneObjects.push_back(new Square("Back Wall", Translate(0.0, 0.0, -2.0)*Scale(2.0,2.0,1.0)));
+        Object::ShadingValues _shadingValues;
+        _shadingValues.color = vec4(0.2,0.8,1.0,1.0);
+        _shadingValues.Ka = 0.0;
+        _shadingValues.Kd = 1.0;
+        _shadingValues.Ks = 0.0;
+        _shadingValues.Kn = 16.0;
+        _shadingValues.Kt = 0.0;
+        _shadingValues.Kr = 0.0;
+        sceneObjects[sceneObjects.size()-1]->setShadingValues(_shadingValues);
+        sceneObjects[sceneObjects.size()-1]->setModelView(mat4());
+    }
+
+    { //Left Wall
+        sceneObjects.push_back(new Square("Left Wall", RotateY(90)*Translate(0.0, 0.0, -2.0)*Scale(2.0,2.0,1.0)));
+        Object::ShadingValues _shadingValues;
+        _shadingValues.color = vec4(1.0,0.0,0.2,1.0);
+        _shadingValues.Ka = 0.0;
+        _shadingValues.Kd = 1.0;
+        _shadingValues.Ks = 0.0;
+        _shadingValues.Kn = 16.0;
+        _shadingValues.Kt = 0.0;
+        _shadingValues.Kr = 0.0;
+        sceneObjects[sceneObjects.size()-1]->setShadingValues(_shadingValues);
+        sceneObjects[sceneObjects.size()-1]->setModelView(mat4());
+    }
+
+    { //Right Wall
+        sceneObjects.push_back(new Square("Right Wall", RotateY(-90)*Translate(0.0, 0.0, -2.0)*Scale(2.0, 2.0, 1.0 )));
+        Object::ShadingValues _shadingValues;
+        _shadingValues.color = vec4(0.5,0.0,0.5,1.0);
+        _shadingValues.Ka = 0.0;
+        _shadingValues.Kd = 1.0;
+        _shadingValues.Ks = 0.0;
+        _shadingValues.Kn = 16.0;
+        _shadingValues.Kt = 0.0;
+        _shadingValues.Kr = 0.0;
+        sceneObjects[sceneObjects.size()-1]->setShadingValues(_shadingValues);
+        sceneObjects[sceneObjects.size()-1]->setModelView(mat4());
+    }
+
+    { //Floor
+        sceneObjects.push_back(new Square("Floor", RotateX(-90)*Translate(0.0, 0.0, -2.0)*Scale(2.0, 2.0, 1.0)));
+        Object::ShadingValues _shadingValues;
+        _shadingValues.color = vec4(0.3,0.3,0.3,1.0);
+        _shadingValues.Ka = 0.0;
+        _shadingValues.Kd = 1.0;
+        _shadingValues.Ks = 0.0;
+        _shadingValues.Kn = 16.0;
+        _shadingValues.Kt = 0.0;
+        _shadingValues.Kr = 0.0;
+        sceneObjects[sceneObjects.size()-1]->setShadingValues(_shadingValues);
+        sceneObjects[sceneObjects.size()-1]->setModelView(mat4());
+    }
+
+    { //Ceiling
+        sceneObjects.push_back(new Square("Ceiling", RotateX(90)*Translate(0.0, 0.0, -2.0)*Scale(2.0, 2.0, 1.0)));
+        Object::ShadingValues _shadingValues;
+        _shadingValues.color = vec4(0.5,0.5,0.5,1.0);
+        _shadingValues.Ka = 0.0;
+        _shadingValues.Kd = 1.0;
+        _shadingValues.Ks = 0.0;
+        _shadingValues.Kn = 16.0;
+        _shadingValues.Kt = 0.0;
+        _shadingValues.Kr = 0.0;
+        sceneObjects[sceneObjects.size()-1]->setShadingValues(_shadingValues);
+        sceneObjects[sceneObjects.size()-1]->setModelView(mat4());
+    }
+
+    { //Front Wall
+        sceneObjects.push_back(new Square("Front Wall",RotateY(180)*Translate(0.0, 0.0, -2.0)*Scale(2.0, 2.0, 1.0)));
+        Object::ShadingValues _shadingValues;
+        _shadingValues.color = vec4(1.0,1.0,1.0,1.0);
+        _shadingValues.Ka = 0.0;
+        _shadingValues.Kd = 1.0;
+        _shadingValues.Ks = 0.0;
+        _shadingValues.Kn = 16.0;
+        _shadingValues.Kt = 0.0;
+        _shadingValues.Kr = 0.0;
+        sceneObjects[sceneObjects.size()-1]->setShadingValues(_shadingValues);
+        sceneObjects[sceneObjects.size()-1]->setModelView(mat4());
+    }
+
+
+    
+    {
+        sceneObjects.push_back(new Sphere("Diffuse Yellow Sphere", vec3(1.35, -1.5, -1.80), 0.15));
+        Object::ShadingValues _shadingValues;
+        _shadingValues.color = vec4(1.0, 1.0, 0.0, 1.0);
+        _shadingValues.Ka = 0.2;
+        _shadingValues.Kd = 0.8;
+        _shadingValues.Ks = 0.005;
+        _shadingValues.Kn = 16.0;
+        _shadingValues.Kt = 0.0;
+        _shadingValues.Kr = 0.0;
+        sceneObjects[sceneObjects.size() - 1]->setShadingValues(_shadingValues);
+        sceneObjects[sceneObjects.size() - 1]->setModelView(mat4());
+    }
+    
+    {
+        sceneObjects.push_back(new Sphere("Glass sphere", vec3(1.0, -1.25, 0.0),0.75));
+        Object::ShadingValues _shadingValues;
+        _shadingValues.color = vec4(1.0,0.0,0.0,1.0);
+        _shadingValues.Ka = 0.0;
+        _shadingValues.Kd = 0.0;
+        _shadingValues.Ks = 0.0; // reflexion speculaire
+        _shadingValues.Kn = 16.0;// shininess
+        _shadingValues.Kt = 0.8; // coefficient de transmission
+        _shadingValues.Kr = 1.4; // indice de refraction
+        sceneObjects[sceneObjects.size()-1]->setShadingValues(_shadingValues);
+        sceneObjects[sceneObjects.size()-1]->setModelView(mat4());
+    }
+    
+    {
+        sceneObjects.push_back(new Sphere("Grey Mirrored Sphere", vec3(-1.0, -1.25, -0.5),0.75));
+        Object::ShadingValues _shadingValues;
+        _shadingValues.color = vec4(0.5,0.5,0.5,1.0);
+        _shadingValues.Ka = 0.0;
+        _shadingValues.Kd = 0.2;
+        _shadingValues.Ks = 0.8;
+        _shadingValues.Kn = 16.0;
+        _shadingValues.Kt = 0.0;
+        _shadingValues.Kr = 0.0;
+        sceneObjects[sceneObjects.size()-1]->setShadingValues(_shadingValues);
+        sceneObjects[sceneObjects.size()-1]->setModelView(mat4());
+    }
+
+
+    {
+        sceneObjects.push_back(new Sphere("Diffuse Green Sphere", vec3(-1.0, -1.75, 0.5), 0.25));
+        Object::ShadingValues _shadingValues;
+        _shadingValues.color = vec4(0.1, 1.0, 0.1, 1.0);
+        _shadingValues.Ka = 0.2;
+        _shadingValues.Kd = 0.8;
+        _shadingValues.Ks = 0.005;
+        _shadingValues.Kn = 32.0;
+        _shadingValues.Kt = 0.0;
+        _shadingValues.Kr = 0.0;
+        sceneObjects[sceneObjects.size() - 1]->setShadingValues(_shadingValues);
+        sceneObjects[sceneObjects.size() - 1]->setModelView(mat4());
+    }
+    
+    
+    
+
+    /*{
+        sceneObjects.push_back(new Sphere("Diffuse Sphere", vec3(1.0, -1.25, 0.5),0.75));
+        Object::ShadingValues _shadingValues;
+        _shadingValues.color = vec4(1.0, 0.0, 0.0, 1.0);
+        _shadingValues.Ka = 0.0;
+        _shadingValues.Kd = 1.0;
+        _shadingValues.Ks = 0.0;
+        _shadingValues.Kn = 16.0;
+        _shadingValues.Kt = 0.0;
+        _shadingValues.Kr = 0.0;
+        sceneObjects[sceneObjects.size() - 1]->setShadingValues(_shadingValues);
+        sceneObjects[sceneObjects.size() - 1]->setModelView(mat4());
+    }*/
+
+    {
+        sceneObjects.push_back(new Sphere("Specular + Diffuse Sphere", vec3(-1.15, -1.75, 0.95),0.25));
+        Object::ShadingValues _shadingValues;
+        _shadingValues.color = vec4(1.0,0.8,0.8,1.0);
+        _shadingValues.Ka = 0.2;
+        _shadingValues.Kd = 0.8;
+        _shadingValues.Ks = 0.10;
+        _shadingValues.Kn = 16.0;
+        _shadingValues.Kt = 0.0;
+        _shadingValues.Kr = 0.0;
+        sceneObjects[sceneObjects.size()-1]->setShadingValues(_shadingValues);
+        sceneObjects[sceneObjects.size()-1]->setModelView(mat4());
+    }
+
+    buildSceneBVH();
+}
+
+
+void initCornellBox2() {
+    cameraPosition = point4(0.0, 0.0, 6.0, 1.0);
+    lightPosition = point4(0.0, 1.5, 0.0, 1.0);
+    lightColor = color4(1.0, 1.0, 1.0, 1.0);
+
+    sceneObjects.clear();
+
+    { //Back Wall
+        sceneObjects.push_back(new Square("Back Wall", Translate(0.0, 0.0, -2.0) * Scale(2.0, 2.0, 1.0)));
+        Object::ShadingValues _shadingValues;
+        _shadingValues.color = vec4(0.2, 0.8, 1.0, 1.0);
+        _shadingValues.Ka = 0.0;
+        _shadingValues.Kd = 1.0;
+        _shadingValues.Ks = 0.0;
+        _shadingValues.Kn = 16.0;
+        _shadingValues.Kt = 0.0;
+        _shadingValues.Kr = 0.0;
+        sceneObjects[sceneObjects.size() - 1]->setShadingValues(_shadingValues);
+        sceneObjects[sceneObjects.size() - 1]->setModelView(mat4());
+    }
+
+    { //Left Wall
+        sceneObjects.push_back(new Square("Left Wall", RotateY(90) * Translate(0.0, 0.0, -2.0) * Scale(2.0, 2.0, 1.0)));
+        Object::ShadingValues _shadingValues;
+        _shadingValues.color = vec4(1.0, 0.0, 0.2, 1.0);
+        _shadingValues.Ka = 0.0;
+        _shadingValues.Kd = 1.0;
+        _shadingValues.Ks = 0.0;
+        _shadingValues.Kn = 16.0;
+        _shadingValues.Kt = 0.0;
+        _shadingValues.Kr = 0.0;
+        sceneObjects[sceneObjects.size() - 1]->setShadingValues(_shadingValues);
+        sceneObjects[sceneObjects.size() - 1]->setModelView(mat4());
+    }
+
+    { //Right Wall
+        sceneObjects.push_back(new Square("Right Wall", RotateY(-90) * Translate(0.0, 0.0, -2.0) * Scale(2.0, 2.0, 1.0)));
+        Object::ShadingValues _shadingValues;
+        _shadingValues.color = vec4(0.5, 0.0, 0.5, 1.0);
+        _shadingValues.Ka = 0.0;
+        _shadingValues.Kd = 1.0;
+        _shadingValues.Ks = 0.0;
+        _shadingValues.Kn = 16.0;
+        _shadingValues.Kt = 0.0;
+        _shadingValues.Kr = 0.0;
+        sceneObjects[sceneObjects.size() - 1]->setShadingValues(_shadingValues);
+        sceneObjects[sceneObjects.size() - 1]->setModelView(mat4());
+    }
+
+    { //Floor
+        sceneObjects.push_back(new Square("Floor", RotateX(-90) * Translate(0.0, 0.0, -2.0) * Scale(2.0, 2.0, 1.0)));
+        Object::ShadingValues _shadingValues;
+        _shadingValues.color = vec4(0.3, 0.3, 0.3, 1.0);
+        _shadingValues.Ka = 0.0;
+        _shadingValues.Kd = 1.0;
+        _shadingValues.Ks = 0.0;
+        _shadingValues.Kn = 16.0;
+        _shadingValues.Kt = 0.0;
+        _shadingValues.Kr = 0.0;
+        sceneObjects[sceneObjects.size() - 1]->setShadingValues(_shadingValues);
+        sceneObjects[sceneObjects.size() - 1]->setModelView(mat4());
+    }
+
+    { //Ceiling
+        sceneObjects.push_back(new Square("Ceiling", RotateX(90) * Translate(0.0, 0.0, -2.0) * Scale(2.0, 2.0, 1.0)));
+        Object::ShadingValues _shadingValues;
+        _shadingValues.color = vec4(0.5, 0.5, 0.5, 1.0);
+        _shadingValues.Ka = 0.0;
+        _shadingValues.Kd = 1.0;
+        _shadingValues.Ks = 0.0;
+        _shadingValues.Kn = 16.0;
+        _shadingValues.Kt = 0.0;
+        _shadingValues.Kr = 0.0;
+        sceneObjects[sceneObjects.size() - 1]->setShadingValues(_shadingValues);
+        sceneObjects[sceneObjects.size() - 1]->setModelView(mat4());
+    }
+
+    { //Front Wall
+        sceneObjects.push_back(new Square("Front Wall", RotateY(180) * Translate(0.0, 0.0, -2.0) * Scale(2.0, 2.0, 1.0)));
+        Object::ShadingValues _shadingValues;
+        _shadingValues.color = vec4(1.0, 1.0, 1.0, 1.0);
+        _shadingValues.Ka = 0.0;
+        _shadingValues.Kd = 1.0;
+        _shadingValues.Ks = 0.0;
+        _shadingValues.Kn = 16.0;
+        _shadingValues.Kt = 0.0;
+        _shadingValues.Kr = 0.0;
+        sceneObjects[sceneObjects.size() - 1]->setShadingValues(_shadingValues);
+        sceneObjects[sceneObjects.size() - 1]->setModelView(mat4());
+    }
+
+    // Diffuse 
+    for (unsigned int ki = 0; ki < 6; ki++)
+    {
+        
+        {
+            vec4 col = vec4(std::rand() / (double)RAND_MAX, std::rand() / (double)RAND_MAX, std::rand() / (double)RAND_MAX, 1.0); 
+            double sizeSp = 0.05 + 0.35*std::rand() / (double)RAND_MAX;
+            double x = -2.0 + sizeSp + (4.0 - 2.0 * sizeSp) * (std::rand() / (double)(RAND_MAX));
+            double z = -1.5 + 2.5 * (std::rand() / (double)(RAND_MAX)); 
+            double y = -2.0 + sizeSp + (4.0 - 2.0 - sizeSp) * (std::rand() / (double)(RAND_MAX));
+            vec3 spherePos = vec3(x, y , z);
+            std::string name = "Amb + Diffuse Sphere " + std::to_string(ki);
+            sceneObjects.push_back(new Sphere(name, spherePos, sizeSp));
+            Object::ShadingValues _shadingValues;
+            _shadingValues.color = col;
+            _shadingValues.Ka = 0.2;
+            _shadingValues.Kd = 0.8;
+            _shadingValues.Ks = 0.0;
+            _shadingValues.Kn = 16.0;
+            _shadingValues.Kt = 0.0;
+            _shadingValues.Kr = 0.0;
+            sceneObjects[sceneObjects.size() - 1]->setShadingValues(_shadingValues);
+            sceneObjects[sceneObjects.size() - 1]->setModelView(mat4());
+        }
+
+        {
+            vec4 col = vec4(std::rand() / (double)RAND_MAX, std::rand() / (double)RAND_MAX, std::rand() / (double)RAND_MAX, 1.0);
+            double sizeSp = 0.05 + 0.35 * std::rand() / (double)RAND_MAX;
+            double x = -2.0 + sizeSp + (4.0 - 2.0 * sizeSp) * (std::rand() / (double)(RAND_MAX));
+            double z = -1.5 + 2.5 * (std::rand() / (double)(RAND_MAX));
+            double y = -2.0 + sizeSp + (4.0 - 2.0 - sizeSp) * (std::rand() / (double)(RAND_MAX));
+            vec3 spherePos = vec3(x, y, z);
+            std::string name = "Amb + Diffuse + Specular Sphere " + std::to_string(ki);
+            sceneObjects.push_back(new Sphere(name, spherePos, sizeSp));
+            Object::ShadingValues _shadingValues;
+            _shadingValues.color = col;
+            _shadingValues.Ka = 0.2;
+            _shadingValues.Kd = 0.8;
+            _shadingValues.Ks = 0.24;
+            _shadingValues.Kn = 16.0;
+            _shadingValues.Kt = 0.0;
+            _shadingValues.Kr = 0.0;
+            sceneObjects[sceneObjects.size() - 1]->setShadingValues(_shadingValues);
+            sceneObjects[sceneObjects.size() - 1]->setModelView(mat4());
+        }
+    }
+
+    // Mirrored
+    for (unsigned int ki = 0; ki < 3; ki++)
+    {
+
+        {
+            vec4 col = vec4(std::rand() / (double)RAND_MAX, std::rand() / (double)RAND_MAX, std::rand() / (double)RAND_MAX, 1.0);
+            double sizeSp = 0.05 + 0.5 * std::rand() / (double)RAND_MAX;
+            double x = -2.0 + sizeSp + (4.0 - 2.0*sizeSp) * (std::rand() / (double)(RAND_MAX));
+            double z = -1.5 + 2.5 * (std::rand() / (double)(RAND_MAX));
+            double y = -2.0 + sizeSp + (4.0 - 2.0 - sizeSp) * (std::rand() / (double)(RAND_MAX));
+            vec3 spherePos = vec3(x, -2.0 + sizeSp, z);
+            std::string name = "Mirrored Sphere " + std::to_string(ki); 
+
+            sceneObjects.push_back(new Sphere(name.c_str(), spherePos, sizeSp));
+            Object::ShadingValues _shadingValues;
+            _shadingValues.color = col;
+            _shadingValues.Ka = 0.0;
+            _shadingValues.Kd = 0.2;
+            _shadingValues.Ks = 0.8;
+            _shadingValues.Kn = 16.0;
+            _shadingValues.Kt = 0.0;
+            _shadingValues.Kr = 0.0;
+            sceneObjects[sceneObjects.size() - 1]->setShadingValues(_shadingValues);
+            sceneObjects[sceneObjects.size() - 1]->setModelView(mat4());
+
+        }
+    }
+
+    // Mini Glass 
+    for (unsigned int ki = 0; ki < 3; ki++)
+    {
+
+        {
+            double sizeSp = 0.05 + 0.35 * std::rand() / (double)RAND_MAX;
+            double x = -2.0 + sizeSp + (4.0 - 2.0 * sizeSp) * (std::rand() / (double)(RAND_MAX));
+            double z = -1.5 + 2.5 * (std::rand() / (double)(RAND_MAX));
+            double y = -2.0 + sizeSp + (4.0 - 2.0 - sizeSp) * (std::rand() / (double)(RAND_MAX));
+            vec3 spherePos = vec3(x, y, z);
+            std::string name = "Glass Sphere " + std::to_string(ki);
+
+            sceneObjects.push_back(new Sphere(name.c_str(), spherePos, sizeSp));
+            Object::ShadingValues _shadingValues;
+            _shadingValues.color = vec4(0.9, 0.1, 0.1, 1.0);
+            _shadingValues.Ka = 0.0;
+            _shadingValues.Kd = 0.0;
+            _shadingValues.Ks = 0.0; // reflexion speculaire
+            _shadingValues.Kn = 16.0;// shininess
+            _shadingValues.Kt = 1.0; // coefficient de transmission
+            _shadingValues.Kr = 1.4; // indice de refraction
+            sceneObjects[sceneObjects.size() - 1]->setShadingValues(_shadingValues);
+            sceneObjects[sceneObjects.size() - 1]->setModelView(mat4());
+
+        }
+    }
+
+
+
+    /*{
+        sceneObjects.push_back(new Sphere("Diffuse Sphere", vec3(1.0, -1.25, -0.5),0.5));
+        Object::ShadingValues _shadingValues;
+        _shadingValues.color = vec4(1.0, 0.0, 0.0, 1.0);
+        _shadingValues.Ka = 0.2;
+        _shadingValues.Kd = 0.8;
+        _shadingValues.Ks = 0.0;
+        _shadingValues.Kn = 16.0;
+        _shadingValues.Kt = 0.0;
+        _shadingValues.Kr = 0.0;
+        sceneObjects[sceneObjects.size() - 1]->setShadingValues(_shadingValues);
+        sceneObjects[sceneObjects.size() - 1]->setModelView(mat4());
+    }
+
+    {
+        sceneObjects.push_back(new Sphere("Ambiant + Diffuse Green Sphere", vec3(0.8, 0.8, -0.5 ), 0.15));
+        Object::ShadingValues _shadingValues;
+        _shadingValues.color = vec4(0.1, 0.8, 0.1, 1.0);
+        _shadingValues.Ka = 0.5;
+        _shadingValues.Kd = 0.5;
+        _shadingValues.Ks = 0.0;
+        _shadingValues.Kn = 8.0;
+        _shadingValues.Kt = 0.0;
+        _shadingValues.Kr = 0.0;
+        sceneObjects[sceneObjects.size() - 1]->setShadingValues(_shadingValues);
+        sceneObjects[sceneObjects.size() - 1]->setModelView(mat4());
+    }
+
+    {
+        sceneObjects.push_back(new Sphere("Silver Sphere", vec3(0.5, 0.0, -1.5), 0.25));
+        Object::ShadingValues _shadingValues;
+        _shadingValues.color = vec4(0.5, 0.5, 0.5, 1.0);
+        _shadingValues.Ka = 0.19225;
+        _shadingValues.Kd = 0.50754;
+        _shadingValues.Ks = 0.50827;
+        _shadingValues.Kn = 32.0;
+        _shadingValues.Kt = 0.0;
+        _shadingValues.Kr = 0.0;
+        sceneObjects[sceneObjects.size() - 1]->setShadingValues(_shadingValues);
+        sceneObjects[sceneObjects.size() - 1]->setModelView(mat4());
+    }
+
+    {
+        sceneObjects.push_back(new Sphere("Diffuse Yellow Sphere", vec3(0.0, -1.75, -1.5), 0.25));
+        Object::ShadingValues _shadingValues;
+        _shadingValues.color = vec4(1.0, 1.0, 0.0, 1.0);
+        _shadingValues.Ka = 0.2;
+        _shadingValues.Kd = 0.8;
+        _shadingValues.Ks = 0.005;
+        _shadingValues.Kn = 16.0;
+        _shadingValues.Kt = 0.0;
+        _shadingValues.Kr = 0.0;
+        sceneObjects[sceneObjects.size() - 1]->setShadingValues(_shadingValues);
+        sceneObjects[sceneObjects.size() - 1]->setModelView(mat4());
+    }
+
+    {
+        sceneObjects.push_back(new Sphere("Specular + Ambient Sphere", vec3(-0.5, -1.25, 0.35),0.25));
+        Object::ShadingValues _shadingValues;
+        _shadingValues.color = vec4(0.2,0.0,1.0,1.0);
+        _shadingValues.Ka = 0.2;
+        _shadingValues.Kd = 0.8;
+        _shadingValues.Ks = 0.2;
+        _shadingValues.Kn = 16.0;
+        _shadingValues.Kt = 0.0;
+        _shadingValues.Kr = 0.0;
+        sceneObjects[sceneObjects.size()-1]->setShadingValues(_shadingValues);
+        sceneObjects[sceneObjects.size()-1]->setModelView(mat4());
+    }
+
+    {
+        sceneObjects.push_back(new Sphere("Grey Mirrored Sphere", vec3(-1.0, -1.25, -0.8), 0.75));
+        Object::ShadingValues _shadingValues;
+        _shadingValues.color = vec4(0.5, 0.5, 0.5, 1.0);
+        _shadingValues.Ka = 0.2;
+        _shadingValues.Kd = 0.5;
+        _shadingValues.Ks = 0.15;
+        _shadingValues.Kn = 16.0;
+        _shadingValues.Kt = 0.0;
+        _shadingValues.Kr = 0.0;
+        sceneObjects[sceneObjects.size() - 1]->setShadingValues(_shadingValues);
+        sceneObjects[sceneObjects.size() - 1]->setModelView(mat4());
+    }
+
+
+    {
+        sceneObjects.push_back(new Sphere("Glass sphere", vec3(1.25, -1.25, 0.25), 0.25));
+        Object::ShadingValues _shadingValues;
+        _shadingValues.color = vec4(1.0, 0.0, 0.0, 1.0);
+        _shadingValues.Ka = 0.0;
+        _shadingValues.Kd = 0.0;
+        _shadingValues.Ks = 0.0; // reflexion speculaire
+        _shadingValues.Kn = 16.0;// shininess
+        _shadingValues.Kt = 1.0; // coefficient de transmission
+        _shadingValues.Kr = 1.4; // indice de refraction
+        sceneObjects[sceneObjects.size() - 1]->setShadingValues(_shadingValues);
+        sceneObjects[sceneObjects.size() - 1]->setModelView(mat4());
+    }*/
+
+    buildSceneBVH();
+}
+
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+void initUnitSphere(){
+    cameraPosition = point4( 0.0, 0.0, 3.0, 1.0 );
+    lightPosition = point4( 0.0, 0.0, 4.0, 1.0 );
+    lightColor = color4( 1.0, 1.0, 1.0, 1.0);
+
+    sceneObjects.clear();
+
+    {
+        {
+            sceneObjects.push_back(new Sphere("Diffuse sphere", vec3(0.5, 0.0, -1.0)));
+            Object::ShadingValues _shadingValues;
+            _shadingValues.color = vec4(1.0, 0.0, 0.0, 1.0);
+            _shadingValues.Ka = 0.0;
+            _shadingValues.Kd = 1.0;
+            _shadingValues.Ks = 0.0;
+            _shadingValues.Kn = 16.0;
+            _shadingValues.Kt = 0.0;
+            _shadingValues.Kr = 0.0;
+            sceneObjects[sceneObjects.size() - 1]->setShadingValues(_shadingValues);
+            sceneObjects[sceneObjects.size() - 1]->setModelView(mat4());
+
+        }
+
+        {
+
+            sceneObjects.push_back(new Sphere("Diffuse sphere2", vec3(-1.0, 0.0, 1.0)));
+            Object::ShadingValues _shadingValues;
+            _shadingValues.color = vec4(0.0, 1.0, 0.0, 1.0);
+            _shadingValues.Ka = 0.0;
+            _shadingValues.Kd = 1.0;
+            _shadingValues.Ks = 0.0;
+            _shadingValues.Kn = 16.0;
+            _shadingValues.Kt = 0.0;
+            _shadingValues.Kr = 0.0;
+            sceneObjects[sceneObjects.size() - 1]->setShadingValues(_shadingValues);
+            sceneObjects[sceneObjects.size() - 1]->setModelView(mat4());
+        }
+    }
+
+    buildSceneBVH();
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+void initUnitSquare(){
+    cameraPosition = point4( 0.0, 0.0, 3.0, 1.0 );
+    lightPosition = point4( 0.0, 0.0, 4.0, 1.0 );
+    lightColor = color4( 1.0, 1.0, 1.0, 1.0);
+
+    sceneObjects.clear();
+
+    { //Back Wall
+        sceneObjects.push_back(new Square("Unit Square"));
+        Object::ShadingValues _shadingValues;
+        _shadingValues.color = vec4(1.0,0.0,0.0,1.0);
+        _shadingValues.Ka = 0.0;
+        _shadingValues.Kd = 1.0;
+        _shadingValues.Ks = 0.0;
+        _shadingValues.Kn = 16.0;
+        _shadingValues.Kt = 0.0;
+        _shadingValues.Kr = 0.0;
+        sceneObjects[sceneObjects.size()-1]->setShadingValues(_shadingValues);
+        sceneObjects[sceneObjects.size()-1]->setModelView(mat4());
+    }
+
+    buildSceneBVH();
+}
+
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+bool initScene(int scene){
+    switch(scene){
+    case _SPHERE:
+        initUnitSphere();
+        return true;
+    case _SQUARE:
+        initUnitSquare();
+        return true;
+    case _BOX:
+        initCornellBox();
+        return true;
+    case _BOXEASYSPHERE:
+        initCornellBox2();
+        return true;
+    }
+    return false;
+}
+
+/* -------------------------------------------------------------------------- */
+/* ---------  OBJ model as a diffuse triangle mesh, scaled so that  --------- */
+/* ---------  its largest side is size and centered on position     --------- */
+bool addObjModel(const char* path, const vec3& position, float size){
+    Mesh model;
+    if (!model.loadOBJ(path)) {
+        return false;
+    }
+
+    // model_view maps the model extents to 0-1 around the origin
+    TriangleMesh* object = new TriangleMesh(path, model, Translate(position) * Scale(size, size, size) * model.model_view);
+    Object::ShadingValues _shadingValues;
+    _shadingValues.color = vec4(0.9, 0.9, 0.9, 1.0);
+    _shadingValues.Ka = 0.1;
+    _shadingValues.Kd = 0.9;
+    _shadingValues.Ks = 0.0;
+    _shadingValues.Kn = 16.0;
+    _shadingValues.Kt = 0.0;
+    _shadingValues.Kr = 0.0;
+    object->setShadingValues(_shadingValues);
+    object->setModelView(mat4());
+    sceneObjects.push_back(object);
+
+    std::cerr << path << " : " << object->getNumTri() << " triangles." << std::endl;
+
+    buildSceneBVH();
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+mat4 sceneProjection(int scene, GLfloat aspect){
+    switch(scene){
+    case _BOX:
+    case _BOXEASYSPHERE:
+        return Perspective( 45.0, aspect, 4.5, 100.0 );
+    default:
+        return Perspective( 45.0, aspect, 0.01, 100.0 );
+    }
+}